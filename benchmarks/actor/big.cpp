@@ -0,0 +1,66 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#include "savina.hpp"
+
+#include <nil/actor/core/future-util.hh>
+#include <nil/actor/core/loop.hh>
+
+#include <nil/actor/actor.hpp>
+#include <nil/actor/actor_ref.hpp>
+
+#include <boost/range/irange.hpp>
+
+#include <functional>
+#include <random>
+
+namespace savina {
+    static constexpr uint64_t big_actors = 120;
+
+    class big_actor : public nil::actor::actor<big_actor> {
+    public:
+        nil::actor::future<> ping() const {
+            return nil::actor::make_ready_future<>();
+        }
+
+        // Pings the given number of random peers, one after the other.
+        nil::actor::future<> run(uint64_t pings) const {
+            auto rng = std::minstd_rand(key + 1);
+            return nil::actor::do_with(rng, [pings](std::minstd_rand &rng) {
+                return nil::actor::do_for_each(boost::irange<uint64_t>(0, pings), [&rng](uint64_t) {
+                    auto peer = std::uniform_int_distribution<uint64_t>(0, big_actors - 1)(rng);
+                    return nil::actor::get<big_actor>(peer)->ping();
+                });
+            });
+        }
+
+        ACTOR_DEFINE_ACTOR(big_actor, (ping)(run));
+    };
+
+    nil::actor::future<uint64_t> big(uint64_t size) {
+        return nil::actor::parallel_for_each(boost::irange<uint64_t>(0, big_actors), [size](uint64_t k) {
+            return nil::actor::get<big_actor>(k)->run(size);
+        }).then([size] { return 2 * size * big_actors; });
+    }
+}    // namespace savina
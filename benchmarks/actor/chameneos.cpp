@@ -0,0 +1,116 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#include "savina.hpp"
+
+#include <nil/actor/core/future-util.hh>
+#include <nil/actor/core/loop.hh>
+
+#include <nil/actor/actor.hpp>
+#include <nil/actor/actor_ref.hpp>
+
+#include <boost/range/irange.hpp>
+
+#include <functional>
+#include <optional>
+#include <utility>
+
+namespace savina {
+    static constexpr uint64_t chameneos_creatures = 10;
+    // meet() result once the mall has hosted all its meetings
+    static constexpr int faded = -1;
+
+    class mall_actor : public nil::actor::actor<mall_actor> {
+        struct waiting {
+            int color;
+            nil::actor::promise<int> partner_color;
+        };
+
+        std::optional<uint64_t> _meetings_left;
+        std::optional<waiting> _waiting;
+
+    public:
+        // Waits for another creature and resolves to the color of that creature, or to faded.
+        nil::actor::future<int> meet(uint64_t meetings, int color) {
+            if (!_meetings_left) {
+                _meetings_left = meetings;
+            }
+            if (*_meetings_left == 0) {
+                if (_waiting) {
+                    _waiting->partner_color.set_value(faded);
+                    _waiting.reset();
+                }
+                return nil::actor::make_ready_future<int>(faded);
+            }
+            if (!_waiting) {
+                _waiting.emplace(waiting {color, nil::actor::promise<int>()});
+                return _waiting->partner_color.get_future();
+            }
+            --*_meetings_left;
+            auto other = std::exchange(_waiting, std::nullopt);
+            other->partner_color.set_value(color);
+            return nil::actor::make_ready_future<int>(other->color);
+        }
+
+        ACTOR_DEFINE_ACTOR(mall_actor, (meet));
+    };
+
+    class chameneo_actor : public nil::actor::actor<chameneo_actor> {
+    public:
+        // Keeps meeting other creatures until the mall is done; returns the messages sent.
+        nil::actor::future<uint64_t> live(uint64_t mall, uint64_t meetings) const {
+            struct state {
+                int color;
+                uint64_t messages = 0;
+                bool done = false;
+            };
+            auto ref = nil::actor::get<mall_actor>(mall);
+            return nil::actor::do_with(state {int(key % 3)}, [ref, meetings](state &st) {
+                return nil::actor::do_until([&st] { return st.done; }, [&st, ref, meetings] {
+                    st.messages++;
+                    return ref->meet(meetings, st.color).then([&st](int partner) {
+                        if (partner == faded) {
+                            st.done = true;
+                        } else if (partner != st.color) {
+                            // both creatures take the third color
+                            st.color = 3 - st.color - partner;
+                        }
+                    });
+                }).then([&st] { return st.messages; });
+            });
+        }
+
+        ACTOR_DEFINE_ACTOR(chameneo_actor, (live));
+    };
+
+    nil::actor::future<uint64_t> chameneos(uint64_t size) {
+        auto run = next_run_key();
+        return nil::actor::map_reduce(
+            boost::irange<uint64_t>(0, chameneos_creatures),
+            [run, size](uint64_t c) {
+                return nil::actor::get<chameneo_actor>(run * chameneos_creatures + c)->live(run, size);
+            },
+            uint64_t(0), std::plus<uint64_t>());
+    }
+}    // namespace savina
@@ -0,0 +1,76 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#include "savina.hpp"
+
+#include <nil/actor/core/loop.hh>
+
+#include <nil/actor/actor.hpp>
+#include <nil/actor/actor_ref.hpp>
+
+#include <boost/range/irange.hpp>
+
+#include <stdexcept>
+
+namespace savina {
+    class counter_actor : public nil::actor::actor<counter_actor> {
+        uint64_t _count = 0;
+
+    public:
+        nil::actor::future<> increment() {
+            _count++;
+            return nil::actor::make_ready_future<>();
+        }
+
+        nil::actor::future<uint64_t> value() const {
+            return nil::actor::make_ready_future<uint64_t>(_count);
+        }
+
+        ACTOR_DEFINE_ACTOR(counter_actor, (increment)(value));
+    };
+
+    class producer_actor : public nil::actor::actor<producer_actor> {
+    public:
+        nil::actor::future<> produce(uint64_t counter, uint64_t count) const {
+            auto ref = nil::actor::get<counter_actor>(counter);
+            return nil::actor::do_for_each(boost::irange<uint64_t>(0, count), [ref](uint64_t) {
+                return ref->increment();
+            }).then([ref, count] {
+                return ref->value().then([count](uint64_t value) {
+                    if (value != count) {
+                        throw std::runtime_error("counting: lost increments");
+                    }
+                });
+            });
+        }
+
+        ACTOR_DEFINE_ACTOR(producer_actor, (produce));
+    };
+
+    nil::actor::future<uint64_t> counting(uint64_t size) {
+        // the producer is on the counter's neighbouring key, so usually on another shard
+        auto run = next_run_key();
+        return nil::actor::get<producer_actor>(run + 1)->produce(run, size).then([size] { return size + 1; });
+    }
+}    // namespace savina
@@ -0,0 +1,72 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#include "savina.hpp"
+
+#include <nil/actor/core/future-util.hh>
+#include <nil/actor/core/loop.hh>
+
+#include <nil/actor/actor.hpp>
+#include <nil/actor/actor_ref.hpp>
+
+#include "../../examples/apps/lib/actor_batch.hh"
+
+#include <boost/range/irange.hpp>
+
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+namespace savina {
+    static constexpr uint64_t fork_join_actors = 60;
+
+    class fork_join_actor : public nil::actor::actor<fork_join_actor> {
+    public:
+        nil::actor::future<> process() const {
+            // the little work every message does in Savina
+            volatile double n = std::sin(37.2);
+            (void)n;
+            return nil::actor::make_ready_future<>();
+        }
+
+        ACTOR_DEFINE_ACTOR(fork_join_actor, (process));
+    };
+
+    nil::actor::future<uint64_t> fork_join_throughput(uint64_t size) {
+        return nil::actor::do_for_each(boost::irange<uint64_t>(0, size), [](uint64_t) {
+            return nil::actor::parallel_for_each(boost::irange<uint64_t>(0, fork_join_actors), [](uint64_t k) {
+                return nil::actor::get<fork_join_actor>(k)->process();
+            });
+        }).then([size] { return size * fork_join_actors; });
+    }
+
+    nil::actor::future<uint64_t> fork_join_throughput_batched(uint64_t size) {
+        return nil::actor::do_for_each(boost::irange<uint64_t>(0, size), [](uint64_t) {
+            std::vector<fork_join_actor::KeyType> keys(fork_join_actors);
+            std::iota(keys.begin(), keys.end(), 0);
+            return actor_apps_lib::tell_all<fork_join_actor>(std::move(keys),
+                                                              [](auto ref) { return ref->process(); });
+        }).then([size] { return size * fork_join_actors; });
+    }
+}    // namespace savina
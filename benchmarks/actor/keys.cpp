@@ -0,0 +1,123 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#include "savina.hpp"
+
+#include <nil/actor/core/future-util.hh>
+#include <nil/actor/core/loop.hh>
+#include <nil/actor/core/reactor.hh>
+#include <nil/actor/core/sharded.hh>
+#include <nil/actor/core/sstring.hh>
+
+#include <nil/actor/actor.hpp>
+#include <nil/actor/actor_ref.hpp>
+
+#include "../../examples/apps/lib/key_table.hh"
+
+#include <boost/range/irange.hpp>
+
+#include <fmt/format.h>
+
+#include <vector>
+
+namespace savina {
+    static constexpr uint64_t keyed_actors = 60;
+
+    // Long enough not to fit in the inline buffer of sstring, like most real-world keys.
+    static std::vector<nil::actor::sstring> key_names() {
+        std::vector<nil::actor::sstring> names;
+        for (uint64_t i = 0; i < keyed_actors; ++i) {
+            names.push_back(fmt::format("customer-account-{:020d}", i));
+        }
+        return names;
+    }
+
+    class string_key_actor : public nil::actor::actor<string_key_actor> {
+    public:
+        using KeyType = nil::actor::sstring;
+
+        nil::actor::future<> receive(KeyType from) const {
+            return nil::actor::make_ready_future<>();
+        }
+
+        ACTOR_DEFINE_ACTOR(string_key_actor, (receive));
+    };
+
+    class interned_key_actor : public nil::actor::actor<interned_key_actor> {
+    public:
+        using KeyType = actor_apps_lib::interned_key;
+
+        nil::actor::future<> receive(KeyType from) const {
+            return nil::actor::make_ready_future<>();
+        }
+
+        ACTOR_DEFINE_ACTOR(interned_key_actor, (receive));
+    };
+
+    // Every round, each actor is sent a message carrying the key of its neighbour.
+    template<typename Actor>
+    static nil::actor::future<uint64_t> send_keyed(std::vector<typename Actor::KeyType> keys, uint64_t size) {
+        return nil::actor::do_with(std::move(keys), [size](auto &keys) {
+            return nil::actor::do_for_each(boost::irange<uint64_t>(0, size), [&keys](uint64_t) {
+                return nil::actor::parallel_for_each(boost::irange<uint64_t>(0, keyed_actors), [&keys](uint64_t k) {
+                    return nil::actor::get<Actor>(keys[k])->receive(keys[(k + 1) % keyed_actors]);
+                });
+            });
+        }).then([size] { return size * keyed_actors; });
+    }
+
+    nil::actor::future<uint64_t> string_keys(uint64_t size) {
+        return send_keyed<string_key_actor>(key_names(), size);
+    }
+
+    static nil::actor::sharded<actor_apps_lib::key_table> key_table;
+
+    nil::actor::future<uint64_t> interned_keys(uint64_t size) {
+        auto started = nil::actor::make_ready_future<>();
+        static bool running = false;
+        if (!running) {
+            running = true;
+            started = key_table.start().then([] {
+                nil::actor::engine().at_exit([] { return key_table.stop(); });
+            });
+        }
+        // interning is a one-time cost, paid by the first (warmup) run
+        // keys[i] is the key of key_names()[i], as in the string benchmark, whatever order they are interned in
+        return started.then([] {
+            return nil::actor::do_with(
+                key_names(), std::vector<actor_apps_lib::interned_key>(keyed_actors), [](auto &names, auto &keys) {
+                    return nil::actor::parallel_for_each(boost::irange<uint64_t>(0, keyed_actors),
+                                                         [&names, &keys](uint64_t i) {
+                                                             return key_table.local().intern(names[i]).then(
+                                                                 [&keys, i](actor_apps_lib::interned_key key) {
+                                                                     keys[i] = key;
+                                                                 });
+                                                         })
+                        .then([&keys] { return std::move(keys); });
+                });
+        }).then([size](std::vector<actor_apps_lib::interned_key> keys) {
+            return send_keyed<interned_key_actor>(std::move(keys), size);
+        });
+    }
+}    // namespace savina
@@ -0,0 +1,183 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+// Savina benchmark driver: runs the selected benchmarks on the current number of shards and
+// writes their timings as JSON. sweep.py runs it over several shard counts.
+
+#include <nil/actor/core/app-template.hh>
+#include <nil/actor/core/print.hh>
+#include <nil/actor/core/smp.hh>
+#include <nil/actor/core/thread.hh>
+
+#include "savina.hpp"
+
+#include <boost/algorithm/string.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+namespace bpo = boost::program_options;
+
+namespace savina {
+    uint64_t next_run_key() {
+        static uint64_t run = 0;
+        return run++;
+    }
+}    // namespace savina
+
+struct benchmark {
+    const char *name;
+    std::function<nil::actor::future<uint64_t>(uint64_t)> run;
+    // problem size at --scale 1, close to Savina's defaults
+    uint64_t size;
+};
+
+static const std::vector<benchmark> benchmarks = {
+    {"ping_pong", savina::ping_pong, 40000},
+    {"fork_join_throughput", savina::fork_join_throughput, 10000},
+    {"fork_join_throughput_batched", savina::fork_join_throughput_batched, 10000},
+    {"dining_philosophers", savina::dining_philosophers, 10000},
+    {"big", savina::big, 2000},
+    {"thread_ring", savina::thread_ring, 100000},
+    {"counting", savina::counting, 1000000},
+    {"chameneos", savina::chameneos, 20000},
+    {"string_keys", savina::string_keys, 10000},
+    {"interned_keys", savina::interned_keys, 10000},
+};
+
+struct result {
+    const benchmark *bench;
+    uint64_t size;
+    uint64_t messages;
+    std::vector<double> durations_usec;
+
+    double mean_usec() const {
+        return std::accumulate(durations_usec.begin(), durations_usec.end(), 0.0) / durations_usec.size();
+    }
+
+    double stddev_usec() const {
+        auto mean = mean_usec();
+        double sq = 0;
+        for (auto d : durations_usec) {
+            sq += (d - mean) * (d - mean);
+        }
+        return std::sqrt(sq / durations_usec.size());
+    }
+
+    double messages_per_sec() const {
+        return messages / (mean_usec() / 1e6);
+    }
+};
+
+result run_benchmark(const benchmark &b, uint64_t size, unsigned iterations) {
+    result res {&b, size, 0, {}};
+    for (unsigned i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        res.messages = b.run(size).get0();
+        auto duration = std::chrono::steady_clock::now() - start;
+        res.durations_usec.push_back(std::chrono::duration<double, std::micro>(duration).count());
+    }
+    std::cerr << fmt::format("{:>30}: {:>12.0f} usec mean, {:>14.0f} messages/s\n", b.name, res.mean_usec(),
+                             res.messages_per_sec());
+    return res;
+}
+
+void write_json(std::ostream &out, const std::vector<result> &results) {
+    out << "{\n";
+    out << fmt::format("  \"shards\": {},\n", nil::actor::smp::count);
+    out << "  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        auto &r = results[i];
+        out << (i ? ",\n" : "\n");
+        out << fmt::format("    {{\"name\": \"{}\", \"size\": {}, \"iterations\": {}, \"messages\": {}, "
+                           "\"mean_usec\": {:.1f}, \"min_usec\": {:.1f}, \"stddev_usec\": {:.1f}, "
+                           "\"messages_per_sec\": {:.0f}}}",
+                           r.bench->name, r.size, r.durations_usec.size(), r.messages, r.mean_usec(),
+                           *std::min_element(r.durations_usec.begin(), r.durations_usec.end()), r.stddev_usec(),
+                           r.messages_per_sec());
+    }
+    out << "\n  ]\n}\n";
+}
+
+int main(int ac, char **av) {
+    nil::actor::app_template app;
+    auto opt_add = app.add_options();
+    opt_add("benchmarks", bpo::value<std::string>()->default_value("all"),
+            "comma-separated benchmarks to run, or all")(
+        "iterations", bpo::value<unsigned>()->default_value(5), "timed runs of every benchmark")(
+        "warmup", bpo::value<unsigned>()->default_value(1), "untimed runs of every benchmark before the timed ones")(
+        "scale", bpo::value<double>()->default_value(1.0), "multiply the problem size of every benchmark")(
+        "output-file", bpo::value<std::string>(), "write the JSON results to this file instead of stdout");
+
+    return app.run(ac, av, [&] {
+        return nil::actor::async([&] {
+            auto &opts = app.configuration();
+            auto names = opts["benchmarks"].as<std::string>();
+            auto iterations = std::max(opts["iterations"].as<unsigned>(), 1u);
+            auto warmup = opts["warmup"].as<unsigned>();
+            auto scale = opts["scale"].as<double>();
+
+            std::vector<const benchmark *> selected;
+            if (names == "all") {
+                for (auto &b : benchmarks) {
+                    selected.push_back(&b);
+                }
+            } else {
+                std::vector<std::string> wanted;
+                boost::split(wanted, names, boost::is_any_of(","));
+                for (auto &name : wanted) {
+                    auto it = std::find_if(benchmarks.begin(), benchmarks.end(),
+                                           [&name](auto &b) { return name == b.name; });
+                    if (it == benchmarks.end()) {
+                        throw std::runtime_error(fmt::format("Unknown benchmark {}", name));
+                    }
+                    selected.push_back(&*it);
+                }
+            }
+
+            std::vector<result> results;
+            for (auto b : selected) {
+                auto size = std::max<uint64_t>(b->size * scale, 1);
+                for (unsigned i = 0; i < warmup; ++i) {
+                    b->run(size).get();
+                }
+                results.push_back(run_benchmark(*b, size, iterations));
+            }
+
+            if (opts.count("output-file")) {
+                std::ofstream out(opts["output-file"].as<std::string>());
+                write_json(out, results);
+            } else {
+                write_json(std::cout, results);
+            }
+        });
+    });
+}
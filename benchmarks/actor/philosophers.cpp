@@ -0,0 +1,104 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#include "savina.hpp"
+
+#include <nil/actor/core/future-util.hh>
+#include <nil/actor/core/loop.hh>
+
+#include <nil/actor/actor.hpp>
+#include <nil/actor/actor_ref.hpp>
+
+#include <boost/range/irange.hpp>
+
+#include <functional>
+#include <vector>
+
+namespace savina {
+    static constexpr uint64_t philosophers = 20;
+
+    class arbitrator_actor : public nil::actor::actor<arbitrator_actor> {
+        std::vector<bool> _forks = std::vector<bool>(philosophers);
+
+    public:
+        // Grants both forks of the philosopher if they are free.
+        nil::actor::future<bool> hungry(uint64_t philosopher) {
+            auto &left = _forks[philosopher];
+            auto &right = _forks[(philosopher + 1) % philosophers];
+            if (left || right) {
+                return nil::actor::make_ready_future<bool>(false);
+            }
+            left = right = true;
+            return nil::actor::make_ready_future<bool>(true);
+        }
+
+        nil::actor::future<> done(uint64_t philosopher) {
+            _forks[philosopher] = _forks[(philosopher + 1) % philosophers] = false;
+            return nil::actor::make_ready_future<>();
+        }
+
+        ACTOR_DEFINE_ACTOR(arbitrator_actor, (hungry)(done));
+    };
+
+    class philosopher_actor : public nil::actor::actor<philosopher_actor> {
+    public:
+        // Eats the given number of meals, retrying while the forks are taken; returns the messages sent.
+        nil::actor::future<uint64_t> dine(uint64_t arbitrator, uint64_t meals) const {
+            struct state {
+                uint64_t eaten = 0;
+                uint64_t messages = 0;
+            };
+            auto arb = nil::actor::get<arbitrator_actor>(arbitrator);
+            auto philosopher = key % philosophers;
+            return nil::actor::do_with(state(), [arb, philosopher, meals](state &st) {
+                auto eat = [&st, arb, philosopher] {
+                    st.messages++;
+                    return arb->hungry(philosopher).then([&st, arb, philosopher](bool granted) {
+                        if (!granted) {
+                            return nil::actor::make_ready_future<>();
+                        }
+                        st.eaten++;
+                        st.messages++;
+                        return arb->done(philosopher);
+                    });
+                };
+                return nil::actor::do_until([&st, meals] { return st.eaten == meals; }, eat).then([&st] {
+                    return st.messages;
+                });
+            });
+        }
+
+        ACTOR_DEFINE_ACTOR(philosopher_actor, (dine));
+    };
+
+    nil::actor::future<uint64_t> dining_philosophers(uint64_t size) {
+        auto run = next_run_key();
+        return nil::actor::map_reduce(
+            boost::irange<uint64_t>(0, philosophers),
+            [run, size](uint64_t p) {
+                return nil::actor::get<philosopher_actor>(run * philosophers + p)->dine(run, size);
+            },
+            uint64_t(0), std::plus<uint64_t>());
+    }
+}    // namespace savina
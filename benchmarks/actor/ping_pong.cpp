@@ -0,0 +1,59 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#include "savina.hpp"
+
+#include <nil/actor/core/loop.hh>
+
+#include <nil/actor/actor.hpp>
+#include <nil/actor/actor_ref.hpp>
+
+#include <boost/range/irange.hpp>
+
+namespace savina {
+    class pong_actor : public nil::actor::actor<pong_actor> {
+    public:
+        nil::actor::future<uint64_t> ping(uint64_t n) const {
+            return nil::actor::make_ready_future<uint64_t>(n);
+        }
+
+        ACTOR_DEFINE_ACTOR(pong_actor, (ping));
+    };
+
+    class ping_actor : public nil::actor::actor<ping_actor> {
+    public:
+        nil::actor::future<> start(uint64_t count) const {
+            // the neighbouring key, so that with more than one shard pong usually lives on another one
+            auto pong = nil::actor::get<pong_actor>(key + 1);
+            return nil::actor::do_for_each(boost::irange<uint64_t>(0, count),
+                                           [pong](uint64_t i) { return pong->ping(i).discard_result(); });
+        }
+
+        ACTOR_DEFINE_ACTOR(ping_actor, (start));
+    };
+
+    nil::actor::future<uint64_t> ping_pong(uint64_t size) {
+        return nil::actor::get<ping_actor>(0)->start(size).then([size] { return 2 * size; });
+    }
+}    // namespace savina
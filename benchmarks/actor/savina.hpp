@@ -0,0 +1,68 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#pragma once
+
+#include <nil/actor/core/future.hh>
+
+#include <cstdint>
+
+// Savina actor benchmarks (https://github.com/shamsimam/savina). Every function runs one
+// iteration of its benchmark with the given problem size, and resolves to the number of
+// messages sent.
+namespace savina {
+    // one-to-one: a ping actor sends size pings to a pong actor, waiting for each reply
+    nil::actor::future<uint64_t> ping_pong(uint64_t size);
+
+    // one-to-many: size messages are sent to each of 60 actors
+    nil::actor::future<uint64_t> fork_join_throughput(uint64_t size);
+
+    // fork_join_throughput, with the messages of every round sent through tell_all()
+    nil::actor::future<uint64_t> fork_join_throughput_batched(uint64_t size);
+
+    // many-to-one: 20 philosophers eat size meals each, asking one arbitrator for their forks
+    nil::actor::future<uint64_t> dining_philosophers(uint64_t size);
+
+    // many-to-many: 120 actors each ping size random peers
+    nil::actor::future<uint64_t> big(uint64_t size);
+
+    // a token is passed size times around a ring of 100 actors
+    nil::actor::future<uint64_t> thread_ring(uint64_t size);
+
+    // a producer increments a counter actor size times, then checks its value
+    nil::actor::future<uint64_t> counting(uint64_t size);
+
+    // 10 chameneos meet size times in one mall
+    nil::actor::future<uint64_t> chameneos(uint64_t size);
+
+    // Not part of Savina: every round, each of 60 actors with long string keys is sent the key
+    // of its neighbour, keyed by the string itself
+    nil::actor::future<uint64_t> string_keys(uint64_t size);
+
+    // string_keys, with the keys interned through a key_table first
+    nil::actor::future<uint64_t> interned_keys(uint64_t size);
+
+    // Key unique to every run, so runs don't share the state of stateful actors.
+    uint64_t next_run_key();
+}    // namespace savina
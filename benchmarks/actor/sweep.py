@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+#---------------------------------------------------------------------------//
+# Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+#
+# MIT License
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#---------------------------------------------------------------------------//
+#
+# Runs the actor benchmarks once per shard count and merges their JSON results, so that runs
+# before and after an upgrade can be diffed.
+#
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+
+def run(binary, smp, extra_args):
+    with tempfile.TemporaryDirectory() as tmp:
+        output = os.path.join(tmp, 'results.json')
+        cmdline = [binary, '--smp={}'.format(smp), '--output-file', output] + extra_args
+        print('Running: ' + ' '.join(cmdline), file=sys.stderr)
+        subprocess.check_call(cmdline)
+        with open(output) as f:
+            return json.load(f)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Sweep the actor benchmarks over shard counts.')
+    parser.add_argument('--binary', required=True, help='path to the actor_benchmarks executable')
+    parser.add_argument('--smp', default='1,2,4', help='comma-separated shard counts to run with')
+    parser.add_argument('--output', help='write the merged JSON here instead of stdout')
+    args, extra_args = parser.parse_known_args()
+
+    runs = [run(args.binary, int(smp), extra_args) for smp in args.smp.split(',')]
+    result = json.dumps({'runs': runs}, indent=2)
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(result + '\n')
+    else:
+        print(result)
+
+
+if __name__ == '__main__':
+    main()
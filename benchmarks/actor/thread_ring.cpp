@@ -0,0 +1,49 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#include "savina.hpp"
+
+#include <nil/actor/actor.hpp>
+#include <nil/actor/actor_ref.hpp>
+
+namespace savina {
+    static constexpr uint64_t ring_actors = 100;
+
+    class ring_actor : public nil::actor::actor<ring_actor> {
+    public:
+        // Passes the token on to the next actor of the ring until it has done all its hops.
+        nil::actor::future<> token(uint64_t hops) const {
+            if (hops == 0) {
+                return nil::actor::make_ready_future<>();
+            }
+            return nil::actor::get<ring_actor>((key + 1) % ring_actors)->token(hops - 1);
+        }
+
+        ACTOR_DEFINE_ACTOR(ring_actor, (token));
+    };
+
+    nil::actor::future<uint64_t> thread_ring(uint64_t size) {
+        return nil::actor::get<ring_actor>(0)->token(size).then([size] { return size; });
+    }
+}    // namespace savina
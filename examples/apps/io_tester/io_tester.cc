@@ -34,35 +34,38 @@
 #include <nil/actor/core/thread.hh>
 #include <nil/actor/core/print.hh>
 #include <nil/actor/core/loop.hh>
+#include <nil/actor/core/gate.hh>
 #include <nil/actor/core/with_scheduling_group.hh>
+#include <nil/actor/detail/defer.hh>
 #include <chrono>
 #include <vector>
 #include <boost/range/irange.hpp>
 #include <boost/algorithm/string.hpp>
-#include <boost/accumulators/accumulators.hpp>
-#include <boost/accumulators/statistics/stats.hpp>
-#include <boost/accumulators/statistics/max.hpp>
-#include <boost/accumulators/statistics/mean.hpp>
-#include <boost/accumulators/statistics/p_square_quantile.hpp>
-#include <boost/accumulators/statistics/extended_p_square.hpp>
-#include <boost/accumulators/statistics/extended_p_square_quantile.hpp>
 #include <boost/range/adaptor/filtered.hpp>
 #include <boost/range/adaptor/map.hpp>
 #include <boost/array.hpp>
+#include <boost/lexical_cast.hpp>
+#include <fstream>
+#include <map>
 #include <iomanip>
+#include <numeric>
+#include <optional>
 #include <random>
 #include <yaml-cpp/yaml.h>
 
+#include "../lib/byte_size.hh"
+#include "../lib/coalescing_file.hh"
+#include "../lib/latency_histogram.hh"
+
 using namespace nil::actor;
 using namespace std::chrono_literals;
-using namespace boost::accumulators;
 
 static auto random_seed =
     std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 static std::default_random_engine random_generator(random_seed);
 
 class context;
-enum class request_type { seqread, seqwrite, randread, randwrite, append, cpu };
+enum class request_type { seqread, seqwrite, randread, randwrite, append, cpu, mixed };
 
 namespace std {
 
@@ -75,9 +78,31 @@ namespace std {
 
 }    // namespace std
 
-struct byte_size {
-    uint64_t size;
-};
+const char *request_type_name(request_type type) {
+    switch (type) {
+        case request_type::seqread:
+            return "seqread";
+        case request_type::seqwrite:
+            return "seqwrite";
+        case request_type::randread:
+            return "randread";
+        case request_type::randwrite:
+            return "randwrite";
+        case request_type::append:
+            return "append";
+        case request_type::cpu:
+            return "cpu";
+        case request_type::mixed:
+            return "mixed";
+    }
+    return "unknown";
+}
+
+bool is_read(request_type type) {
+    return (type == request_type::seqread) || (type == request_type::randread);
+}
+
+using actor_apps_lib::byte_size;
 
 struct duration_time {
     std::chrono::duration<float> time;
@@ -95,6 +120,15 @@ public:
     bool is_set(unsigned cpu) const {
         return _shards.count(cpu);
     }
+
+    unsigned count() const {
+        return _shards.size();
+    }
+
+    // Position of the shard among the shards of the set.
+    unsigned index_of(unsigned cpu) const {
+        return std::count_if(_shards.begin(), _shards.end(), [cpu](unsigned s) { return s < cpu; });
+    }
 };
 
 struct shard_info {
@@ -103,13 +137,39 @@ struct shard_info {
     uint64_t request_size = 4 << 10;
     std::chrono::duration<float> think_time = 0ms;
     std::chrono::duration<float> execution_time = 1ms;
+    // Open-loop limits; zero means requests are issued back to back by `parallelism` fibers.
+    double rps = 0;
+    uint64_t bandwidth = 0;
+    // I/O loads only: p99 latency goal; zero means none
+    std::chrono::duration<float> latency_target = 0ms;
     nil::actor::scheduling_group scheduling_group = nil::actor::default_scheduling_group();
 };
 
 struct options {
     bool dsync = false;
+    // Jobs with the same shared_file operate on one file, across classes and shards.
+    std::string shared_file;
+    // Flush the file after every that many writes of the job; 0 disables.
+    unsigned flush_every = 0;
+    // Submit at most that many I/Os at a time and merge adjacent requests queued behind them; 0 disables.
+    unsigned coalesce_depth = 0;
 };
 
+// Requests per second to issue in open-loop mode, or 0 for closed-loop.
+double open_loop_rate(const shard_info &si) {
+    double rate = si.rps;
+    if (si.bandwidth) {
+        double bw_rate = double(si.bandwidth) / si.request_size;
+        rate = rate ? std::min(rate, bw_rate) : bw_rate;
+    }
+    return rate;
+}
+
+// Time between two open-loop requests; zero if the rate is beyond what the clock can pace.
+std::chrono::steady_clock::duration rate_period(double rate) {
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / rate));
+}
+
 class class_data;
 
 struct job_config {
@@ -118,78 +178,438 @@ struct job_config {
     shard_config shard_placement;
     ::shard_info shard_info;
     ::options options;
+    // mixed jobs only: relative frequency of each request type
+    std::vector<std::pair<request_type, unsigned>> ratios;
     // size of each individual file. Every class and every shard have its file, so in a normal
     // system with many shards we'll naturally have many files and that will push the data out
-    // of the disk's cache
+    // of the disk's cache. Shared files are sized by data_size as a whole.
     uint64_t file_size;
     std::unique_ptr<class_data> gen_class_data();
 };
 
 std::array<double, 4> quantiles = {0.5, 0.95, 0.99, 0.999};
 
+// Results of one class, either of a single shard or merged across all shards running it.
+struct class_stats {
+    std::string name;
+    request_type type;
+    // request type, or "flush", these results are about; a mixed class reports one entry per op
+    std::string op;
+    unsigned shards = 1;
+    uint64_t data = 0;
+    uint64_t requests = 0;
+    // requests merged into another I/O, final results of coalescing jobs only
+    uint64_t merged = 0;
+    // open-loop requests due before the end of the run that were never issued
+    uint64_t dropped = 0;
+    std::chrono::duration<float> duration {0};
+    actor_apps_lib::latency_histogram latencies;
+    // I/O loads only: time spent held back by the latency governor, and spent in the I/O itself
+    actor_apps_lib::latency_histogram queue_latencies;
+    actor_apps_lib::latency_histogram disk_latencies;
+
+    class_stats &operator+=(const class_stats &o) {
+        shards += o.shards;
+        data += o.data;
+        requests += o.requests;
+        merged += o.merged;
+        dropped += o.dropped;
+        // shards run concurrently, so the merged class ran for as long as its slowest job
+        duration = std::max(duration, o.duration);
+        latencies += o.latencies;
+        queue_latencies += o.queue_latencies;
+        disk_latencies += o.disk_latencies;
+        return *this;
+    }
+
+    double throughput_kbs() const {
+        return duration.count() ? (data >> 10) / duration.count() : 0;
+    }
+
+    double iops() const {
+        return duration.count() ? requests / duration.count() : 0;
+    }
+
+    // Class name, followed by the op when it isn't implied by the class type.
+    std::string label() const {
+        return op == request_type_name(type) ? name : name + "/" + op;
+    }
+};
+
+// Merges per-shard results of the same class and op, ordering them by name.
+std::vector<class_stats> merge_class_stats(std::vector<class_stats> all) {
+    std::vector<class_stats> merged;
+    for (auto &st : all) {
+        auto it = std::find_if(merged.begin(), merged.end(),
+                               [&st](auto &m) { return m.name == st.name && m.op == st.op; });
+        if (it == merged.end()) {
+            merged.push_back(std::move(st));
+        } else {
+            *it += st;
+        }
+    }
+    std::sort(merged.begin(), merged.end(),
+              [](auto &a, auto &b) { return std::tie(a.name, a.op) < std::tie(b.name, b.op); });
+    return merged;
+}
+
+std::vector<class_stats> concat_class_stats(std::vector<class_stats> a, std::vector<class_stats> b) {
+    std::move(b.begin(), b.end(), std::back_inserter(a));
+    return a;
+}
+
+sstring describe_io_results(const class_stats &st) {
+    sstring result;
+    result += fmt::format("  Throughput         : {:>8.0f} KB/s\n", st.throughput_kbs());
+    result += fmt::format("  IOPS               : {:>8.0f}\n", st.iops());
+    result += fmt::format("  Lat average        : {:>8.0f} usec\n", st.latencies.mean());
+    for (auto &q : quantiles) {
+        result += fmt::format("  Lat quantile={:>5} : {:>8} usec\n", q, st.latencies.quantile(q));
+    }
+    result += fmt::format("  Lat max            : {:>8} usec\n", st.latencies.max());
+    if (st.queue_latencies.count()) {
+        result += fmt::format("  Queue lat p50/p99  : {:>8} / {} usec\n", st.queue_latencies.quantile(0.5),
+                              st.queue_latencies.quantile(0.99));
+    }
+    if (st.disk_latencies.count()) {
+        result += fmt::format("  Disk lat p50/p99   : {:>8} / {} usec\n", st.disk_latencies.quantile(0.5),
+                              st.disk_latencies.quantile(0.99));
+    }
+    if (st.merged) {
+        result += fmt::format("  Merged requests    : {:>8} ({:.1f}%)\n", st.merged, st.merged * 100.0 / st.requests);
+    }
+    if (st.dropped) {
+        result += fmt::format("  Dropped requests   : {:>8}\n", st.dropped);
+    }
+    return result;
+}
+
+sstring describe_cpu_results(const class_stats &st) {
+    return fmt::format("  Throughput         : {:>8.0f} continuations/s\n",
+                       st.duration.count() ? st.data / st.duration.count() : 0);
+}
+
+constexpr uint64_t fill_buffer_size = 256ul << 10;
+
+// Writes size bytes (rounded up to fill_buffer_size) of garbage to the file, so reads hit allocated extents.
+future<> fill_file(file f, uint64_t size) {
+    return do_with(nil::actor::semaphore(64), [f, size](auto &write_parallelism) mutable {
+        auto pos = boost::irange(0ul, (size / fill_buffer_size) + 1);
+        return parallel_for_each(pos.begin(), pos.end(), [f, &write_parallelism](auto pos) mutable {
+            return get_units(write_parallelism, 1).then([f, pos](auto perm) mutable {
+                auto bufptr = allocate_aligned_buffer<char>(fill_buffer_size, 4096);
+                auto buf = bufptr.get();
+                std::uniform_int_distribution<char> fill('@', '~');
+                memset(buf, fill(random_generator), fill_buffer_size);
+                return f.dma_write(pos * fill_buffer_size, buf, fill_buffer_size)
+                    .finally([bufptr = std::move(bufptr), perm = std::move(perm)] {})
+                    .discard_result();
+            });
+        });
+    }).then([f]() mutable { return f.flush(); });
+}
+
+sstring shared_file_name(sstring dir, const std::string &name) {
+    return format("{}/shared-{}", dir, name);
+}
+
+// Keeps the p99 latency of the I/O classes of a shard that have a latency target below it, by
+// limiting how many requests the I/O classes with fewer shares than all of them may have in flight. Every
+// adjust_period the limit is halved if any target class saw its p99 latency above its target
+// during the period, and raised by one otherwise.
+class latency_governor {
+    struct target {
+        std::chrono::microseconds goal;
+        actor_apps_lib::latency_histogram window;
+    };
+
+    static constexpr auto adjust_period = 50ms;
+
+    std::vector<target> _targets;
+    unsigned _min_target_shares = std::numeric_limits<unsigned>::max();
+    unsigned _max_limit = 0;
+    unsigned _limit = 0;
+    semaphore _slots {0};
+    timer<> _adjust;
+
+    void adjust() {
+        bool missed = false;
+        for (auto &t : _targets) {
+            missed |= t.window.count() && t.window.quantile(0.99) > uint64_t(t.goal.count());
+            t.window.reset();
+        }
+        auto limit = missed ? std::max(_limit / 2, 1u) : std::min(_limit + 1, _max_limit);
+        if (limit > _limit) {
+            _slots.signal(limit - _limit);
+        } else {
+            // may leave the semaphore negative until enough requests in flight complete
+            _slots.consume(_limit - limit);
+        }
+        _limit = limit;
+    }
+
+public:
+    latency_governor() : _adjust([this] { adjust(); }) {
+    }
+
+    unsigned add_target(std::chrono::microseconds goal, unsigned shares) {
+        _targets.push_back(target {goal, {}});
+        _min_target_shares = std::min(_min_target_shares, shares);
+        return _targets.size() - 1;
+    }
+
+    bool throttles(unsigned shares) const {
+        return !_targets.empty() && shares < _min_target_shares;
+    }
+
+    // Called once per throttled class, with the most requests it can have in flight.
+    void add_throttled(unsigned parallelism) {
+        _max_limit += parallelism;
+        _limit += parallelism;
+        _slots.signal(parallelism);
+    }
+
+    void start() {
+        if (_max_limit) {
+            _adjust.arm_periodic(adjust_period);
+        }
+    }
+
+    void stop() {
+        _adjust.cancel();
+    }
+
+    void record(unsigned target, std::chrono::microseconds latency) {
+        _targets[target].window.record(latency.count());
+    }
+
+    future<semaphore_units<>> admit() {
+        return get_units(_slots, 1);
+    }
+};
+
 class class_data {
 protected:
-    using accumulator_type =
-        accumulator_set<double, stats<tag::extended_p_square_quantile(quadratic), tag::mean, tag::max>>;
-
     job_config _config;
     uint64_t _alignment;
-    uint64_t _last_pos = 0;
-
     io_priority_class _iop;
     nil::actor::scheduling_group _sg;
 
-    size_t _data = 0;
+    struct op_counters {
+        uint64_t data = 0;
+        uint64_t requests = 0;
+        uint64_t dropped = 0;
+        actor_apps_lib::latency_histogram latencies;
+        actor_apps_lib::latency_histogram queue_latencies;
+        actor_apps_lib::latency_histogram disk_latencies;
+
+        void add(size_t size, std::chrono::microseconds latency) {
+            data += size;
+            requests++;
+            latencies.record(latency.count());
+        }
+    };
+
+    latency_governor *_governor = nullptr;
+    bool _throttled = false;
+    std::optional<unsigned> _latency_target;
+
     std::chrono::duration<float> _total_duration;
 
     std::chrono::steady_clock::time_point _start = {};
-    accumulator_type _latencies;
-    uint64_t _requests = 0;
+    // Request types this class issues; mixed classes pick one per request with _op_distribution.
+    std::vector<request_type> _ops;
+    std::discrete_distribution<unsigned> _op_distribution;
+    // Last position of each op, indexed like _ops, so sequential ops of a mixed class stay sequential.
+    std::vector<uint64_t> _last_pos;
+    // Range sequential ops go through: the whole file, or the shard's own slice of a shared file.
+    uint64_t _seq_begin = 0;
+    uint64_t _seq_end = 0;
+    std::optional<unsigned> _flush_op;
+    unsigned _writes_since_flush = 0;
+    // Indexed like _ops, followed by the flush op if any.
+    std::vector<op_counters> _totals;
+    // Counters since the last take_interval(), for the periodic report.
+    std::chrono::steady_clock::time_point _interval_start = {};
+    std::vector<op_counters> _interval;
     std::uniform_int_distribution<uint32_t> _pos_distribution;
     file _file;
 
     virtual future<> do_start(sstring dir) = 0;
-    virtual future<size_t> issue_request(char *buf) = 0;
+    virtual future<size_t> issue_request(char *buf, request_type op) = 0;
+    virtual uint64_t merged_requests(request_type op) const {
+        return 0;
+    }
 
 public:
     static int idgen();
     class_data(job_config cfg) :
         _config(std::move(cfg)), _alignment(_config.shard_info.request_size >= 4096 ? 4096 : 512),
         _iop(engine().register_one_priority_class(format("test-class-{:d}", idgen()), _config.shard_info.shares)),
-        _sg(cfg.shard_info.scheduling_group), _latencies(extended_p_square_probabilities = quantiles),
-        _pos_distribution(0, _config.file_size / _config.shard_info.request_size) {
+        _sg(cfg.shard_info.scheduling_group), _pos_distribution(0, _config.file_size / _config.shard_info.request_size) {
+        if (_config.type == request_type::mixed) {
+            std::vector<unsigned> weights;
+            for (auto &r : _config.ratios) {
+                _ops.push_back(r.first);
+                weights.push_back(r.second);
+            }
+            _op_distribution = std::discrete_distribution<unsigned>(weights.begin(), weights.end());
+        } else {
+            _ops.push_back(_config.type);
+        }
+        bool writes = std::any_of(_ops.begin(), _ops.end(),
+                                  [](auto t) { return t != request_type::cpu && !is_read(t); });
+        if (writes && _config.options.flush_every) {
+            _flush_op = _ops.size();
+        }
+        _seq_end = _config.file_size;
+        if (!_config.options.shared_file.empty()) {
+            // Shards of a shared file each go through their own slice of it sequentially, so that
+            // sequential writes of several shards don't write the same offsets at the same time.
+            auto slice = std::max<uint64_t>(
+                _config.file_size / _config.shard_placement.count() / req_size() * req_size(), req_size());
+            _seq_begin = std::min(slice * _config.shard_placement.index_of(this_shard_id()), _config.file_size);
+            _seq_end = std::min(_seq_begin + slice, _config.file_size);
+        }
+        _last_pos.resize(_ops.size(), _seq_begin);
+        _totals.resize(_ops.size() + bool(_flush_op));
+        _interval.resize(_totals.size());
     }
 
     virtual ~class_data() = default;
 
     future<> issue_requests(std::chrono::steady_clock::time_point stop) {
         _start = std::chrono::steady_clock::now();
-        return with_scheduling_group(
-                   _sg,
-                   [this, stop] {
-                       return parallel_for_each(boost::irange(0u, parallelism()), [this, stop](auto dummy) mutable {
-                           auto bufptr = allocate_aligned_buffer<char>(this->req_size(), _alignment);
-                           auto buf = bufptr.get();
-                           return do_until([stop] { return std::chrono::steady_clock::now() > stop; },
-                                           [this, buf, stop]() mutable {
-                                               auto start = std::chrono::steady_clock::now();
-                                               return issue_request(buf).then([this, start, stop](auto size) {
-                                                   auto now = std::chrono::steady_clock::now();
-                                                   if (now < stop) {
-                                                       this->add_result(
-                                                           size,
-                                                           std::chrono::duration_cast<std::chrono::microseconds>(
-                                                               now - start));
-                                                   }
-                                                   return think();
-                                               });
-                                           })
-                               .finally([bufptr = std::move(bufptr)] {});
-                       });
-                   })
+        _interval_start = _start;
+        return with_scheduling_group(_sg,
+                                     [this, stop] {
+                                         return request_rate() ? issue_requests_at_rate(stop)
+                                                               : issue_requests_in_parallel(stop);
+                                     })
             .then([this] { _total_duration = std::chrono::steady_clock::now() - _start; });
     }
 
+    // Closed loop: `parallelism` fibers, each issuing its next request once the previous one completes.
+    future<> issue_requests_in_parallel(std::chrono::steady_clock::time_point stop) {
+        return parallel_for_each(boost::irange(0u, parallelism()), [this, stop](auto dummy) mutable {
+            auto bufptr = allocate_aligned_buffer<char>(this->req_size(), _alignment);
+            auto buf = bufptr.get();
+            return do_until([stop] { return std::chrono::steady_clock::now() > stop; },
+                            [this, buf, stop]() mutable {
+                                auto start = std::chrono::steady_clock::now();
+                                auto op = next_op();
+                                return issue_governed(buf, op, stop).then([this, start, stop, op](auto size) {
+                                    auto now = std::chrono::steady_clock::now();
+                                    if (now < stop) {
+                                        auto latency =
+                                            std::chrono::duration_cast<std::chrono::microseconds>(now - start);
+                                        this->add_result(op, size, latency);
+                                    }
+                                    return maybe_flush(op, stop).then([this] { return think(); });
+                                });
+                            })
+                .finally([bufptr = std::move(bufptr)] {});
+        });
+    }
+
+    // Open loop: request n is due at _start + n / rate regardless of how long earlier requests take,
+    // and its latency is measured from that intended time. If the device cannot keep up, requests
+    // wait for one of the `parallelism` in-flight slots and that wait shows up as latency instead of
+    // silently lowering the offered load. Requests still waiting for their slot when the run ends
+    // are not issued and are counted as dropped instead.
+    future<> issue_requests_at_rate(std::chrono::steady_clock::time_point stop) {
+        struct issue_state {
+            semaphore in_flight;
+            gate pending;
+            // requests scheduled so far, and those of them actually issued
+            uint64_t scheduled = 0;
+            uint64_t issued = 0;
+            std::exception_ptr error;
+            explicit issue_state(unsigned parallelism) : in_flight(parallelism) {
+            }
+        };
+        auto period = rate_period(request_rate());
+        auto st = make_lw_shared<issue_state>(parallelism());
+        return do_until(
+                   [this, stop, period, st] {
+                       return _start + period * st->scheduled > stop || std::chrono::steady_clock::now() >= stop ||
+                              st->error;
+                   },
+                   [this, stop, period, st] {
+                       auto intended = _start + period * st->scheduled++;
+                       auto now = std::chrono::steady_clock::now();
+                       auto due = intended > now ? nil::actor::sleep(
+                                                       std::chrono::duration_cast<std::chrono::microseconds>(
+                                                           intended - now))
+                                                 : make_ready_future<>();
+                       return due.then([st] { return get_units(st->in_flight, 1); })
+                           .then([this, stop, intended, st](auto units) {
+                               if (std::chrono::steady_clock::now() >= stop) {
+                                   return;
+                               }
+                               st->issued++;
+                               // Run in the background; the gate is closed once all requests are issued.
+                               (void)with_gate(st->pending,
+                                               [this, stop, intended, units = std::move(units)]() mutable {
+                                                   return issue_request_at(intended, stop)
+                                                       .finally([units = std::move(units)] {});
+                                               })
+                                   .handle_exception([st](std::exception_ptr ep) { st->error = ep; });
+                           });
+                   })
+            .then([this, stop, period, st] {
+                record_dropped((stop - _start) / period + 1 - st->issued);
+                return st->pending.close();
+            })
+            .then([st] {
+                if (st->error) {
+                    std::rethrow_exception(st->error);
+                }
+            });
+    }
+
+    // Attributes requests that were due but never issued to the ops they would have been.
+    void record_dropped(uint64_t count) {
+        for (uint64_t i = 0; i < count; ++i) {
+            auto op = next_op();
+            _totals[op].dropped++;
+            _interval[op].dropped++;
+        }
+    }
+
+    future<> issue_request_at(std::chrono::steady_clock::time_point intended,
+                              std::chrono::steady_clock::time_point stop) {
+        auto bufptr = allocate_aligned_buffer<char>(this->req_size(), _alignment);
+        auto buf = bufptr.get();
+        auto op = next_op();
+        return issue_governed(buf, op, stop).then([this, intended, stop, op, bufptr = std::move(bufptr)](auto size) {
+            auto now = std::chrono::steady_clock::now();
+            if (now < stop) {
+                this->add_result(op, size, std::chrono::duration_cast<std::chrono::microseconds>(now - intended));
+            }
+            return maybe_flush(op, stop);
+        });
+    }
+
+    unsigned next_op() {
+        return _ops.size() == 1 ? 0 : _op_distribution(random_generator);
+    }
+
+    // Flushes the file after every options.flush_every writes, recording the flush as its own op.
+    future<> maybe_flush(unsigned op, std::chrono::steady_clock::time_point stop) {
+        if (!_flush_op || is_read(_ops[op]) || ++_writes_since_flush < _config.options.flush_every) {
+            return make_ready_future<>();
+        }
+        _writes_since_flush = 0;
+        auto start = std::chrono::steady_clock::now();
+        return _file.flush().then([this, start, stop] {
+            auto now = std::chrono::steady_clock::now();
+            if (now < stop) {
+                this->add_result(*_flush_op, 0, std::chrono::duration_cast<std::chrono::microseconds>(now - start));
+            }
+        });
+    }
+
     future<> think() {
         if (_config.shard_info.think_time > 0us) {
             return nil::actor::sleep(
@@ -208,6 +628,10 @@ public:
     // random writes     : will overwrite the file at a random position, between 0 and EOF
     // append            : will write to the file from pos = EOF onwards, always appending to the end.
     // cpu               : CPU-only load, file is not created.
+    // mixed             : each request is one of the above I/O types, picked according to the job's ratios.
+    //
+    // Jobs with a shared_file option instead open a file created once for all of them before the test.
+    // Their random ops go anywhere in it, while their sequential ops go through a slice of it per shard.
     future<> start(sstring dir) {
         return do_start(dir);
     }
@@ -221,6 +645,16 @@ public:
 
 protected:
     sstring type_str() const {
+        if (_config.type == request_type::mixed) {
+            auto total = std::accumulate(_config.ratios.begin(), _config.ratios.end(), 0u,
+                                         [](unsigned sum, auto &r) { return sum + r.second; });
+            sstring mix;
+            for (auto &r : _config.ratios) {
+                mix += format("{}{:.0f}% {}", mix.empty() ? "" : ", ", r.second * 100.0 / total,
+                              request_type_name(r.first));
+            }
+            return format("MIXED ({})", mix);
+        }
         return std::unordered_map<request_type, sstring> {
             {request_type::seqread, "SEQ READ"},   {request_type::seqwrite, "SEQ WRITE"},
             {request_type::randread, "RAND READ"}, {request_type::randwrite, "RAND WRITE"},
@@ -258,6 +692,36 @@ protected:
         return _config.shard_info.shares;
     }
 
+    // Registers the class with the shard's governor: as a target if it has a latency target, then,
+    // once all targets are known, as throttled if it has fewer shares than they do.
+    void set_latency_target(latency_governor &governor) {
+        auto goal = std::chrono::duration_cast<std::chrono::microseconds>(_config.shard_info.latency_target);
+        if (_config.type != request_type::cpu && goal.count() > 0) {
+            _governor = &governor;
+            _latency_target = governor.add_target(goal, shares());
+        }
+    }
+
+    void set_throttled(latency_governor &governor) {
+        if (_config.type != request_type::cpu && governor.throttles(shares())) {
+            _governor = &governor;
+            _throttled = true;
+            governor.add_throttled(parallelism());
+        }
+    }
+
+    // Requests per second to issue in open-loop mode, or 0 for closed-loop.
+    double request_rate() const {
+        return open_loop_rate(_config.shard_info);
+    }
+
+    sstring issue_mode() const {
+        if (request_rate()) {
+            return format("open-loop at {:.0f} requests/s, up to {} in flight", request_rate(), parallelism());
+        }
+        return format("{} concurrent requests", parallelism());
+    }
+
     std::chrono::duration<float> total_duration() const {
         return _total_duration;
     }
@@ -266,123 +730,207 @@ protected:
         return _config.file_size >> 20;
     }
 
-    uint64_t total_data() const {
-        return _data;
+    static bool is_sequential(request_type type) {
+        return (type == request_type::seqread) || (type == request_type::seqwrite);
     }
-
-    uint64_t max_latency() const {
-        return max(_latencies);
+    static bool is_random(request_type type) {
+        return (type == request_type::randread) || (type == request_type::randwrite);
     }
 
-    uint64_t average_latency() const {
-        return mean(_latencies);
+    uint64_t get_pos(request_type type) {
+        if (is_random(type)) {
+            return _pos_distribution(random_generator) * req_size();
+        }
+        auto &last_pos = _last_pos[std::find(_ops.begin(), _ops.end(), type) - _ops.begin()];
+        auto pos = last_pos + req_size();
+        if (is_sequential(type) && (pos >= _seq_end)) {
+            pos = _seq_begin;
+        }
+        last_pos = pos;
+        return pos;
     }
 
-    uint64_t quantile_latency(double q) const {
-        return quantile(_latencies, quantile_probability = q);
+    void add_result(unsigned op, size_t data, std::chrono::microseconds latency) {
+        _totals[op].add(data, latency);
+        _interval[op].add(data, latency);
+        // the target is about the latency of requests; flushes only report theirs
+        if (_latency_target && op != _flush_op) {
+            _governor->record(*_latency_target, latency);
+        }
     }
 
-    uint64_t requests() const noexcept {
-        return _requests;
+    // Issues a request, first waiting for the governor if it throttles this class. Classes the
+    // governor knows about also record the time spent waiting and the time spent in the I/O itself.
+    future<size_t> issue_governed(char *buf, unsigned op, std::chrono::steady_clock::time_point stop) {
+        if (!_governor) {
+            return issue_request(buf, _ops[op]);
+        }
+        if (!_throttled) {
+            return issue_measured(buf, op, stop);
+        }
+        auto queued = std::chrono::steady_clock::now();
+        return _governor->admit().then([this, buf, op, stop, queued](auto units) {
+            auto now = std::chrono::steady_clock::now();
+            if (now < stop) {
+                auto wait = std::chrono::duration_cast<std::chrono::microseconds>(now - queued).count();
+                _totals[op].queue_latencies.record(wait);
+                _interval[op].queue_latencies.record(wait);
+            }
+            return issue_measured(buf, op, stop).finally([units = std::move(units)] {});
+        });
     }
 
-    bool is_sequential() const {
-        return (req_type() == request_type::seqread) || (req_type() == request_type::seqwrite);
+    future<size_t> issue_measured(char *buf, unsigned op, std::chrono::steady_clock::time_point stop) {
+        auto start = std::chrono::steady_clock::now();
+        return issue_request(buf, _ops[op]).then([this, op, stop, start](size_t size) {
+            auto now = std::chrono::steady_clock::now();
+            if (now < stop) {
+                auto latency = std::chrono::duration_cast<std::chrono::microseconds>(now - start).count();
+                _totals[op].disk_latencies.record(latency);
+                _interval[op].disk_latencies.record(latency);
+            }
+            return size;
+        });
     }
-    bool is_random() const {
-        return (req_type() == request_type::randread) || (req_type() == request_type::randwrite);
+
+    sstring op_name(unsigned op) const {
+        return op == _flush_op ? "flush" : request_type_name(_ops[op]);
     }
 
-    uint64_t get_pos() {
-        uint64_t pos;
-        if (is_random()) {
-            pos = _pos_distribution(random_generator) * req_size();
-        } else {
-            pos = _last_pos + req_size();
-            if (is_sequential() && (pos >= _config.file_size)) {
-                pos = 0;
-            }
+    std::vector<class_stats> make_stats(const std::vector<op_counters> &counters,
+                                        std::chrono::duration<float> duration) const {
+        std::vector<class_stats> res;
+        for (unsigned op = 0; op < counters.size(); ++op) {
+            class_stats st;
+            st.name = name();
+            st.type = req_type();
+            st.op = op_name(op);
+            st.data = counters[op].data;
+            st.requests = counters[op].requests;
+            st.dropped = counters[op].dropped;
+            st.duration = duration;
+            st.latencies = counters[op].latencies;
+            st.queue_latencies = counters[op].queue_latencies;
+            st.disk_latencies = counters[op].disk_latencies;
+            res.push_back(std::move(st));
         }
-        _last_pos = pos;
-        return pos;
+        return res;
     }
 
-    void add_result(size_t data, std::chrono::microseconds latency) {
-        _data += data;
-        _latencies(latency.count());
-        _requests++;
+    // Describes every op of the class; single-op classes keep the plain layout.
+    sstring describe_ops(std::function<sstring(const class_stats &)> describe) const {
+        auto all = stats();
+        if (all.size() == 1) {
+            return describe(all.front());
+        }
+        sstring result;
+        for (auto &st : all) {
+            result += fmt::format(" {}:\n{}", st.op, describe(st));
+        }
+        return result;
     }
 
 public:
     virtual sstring describe_class() = 0;
     virtual sstring describe_results() = 0;
+
+    std::vector<class_stats> stats() const {
+        auto res = make_stats(_totals, _total_duration);
+        for (unsigned op = 0; op < _ops.size(); ++op) {
+            res[op].merged = merged_requests(_ops[op]);
+        }
+        return res;
+    }
+
+    // Returns what happened since the previous call and starts a new interval.
+    std::vector<class_stats> take_interval() {
+        auto now = std::chrono::steady_clock::now();
+        auto st = make_stats(_interval, now - _interval_start);
+        _interval_start = now;
+        for (auto &c : _interval) {
+            c = op_counters();
+        }
+        return st;
+    }
 };
 
 class io_class_data : public class_data {
+protected:
+    std::unique_ptr<actor_apps_lib::coalescing_file> _coalescer;
+
+    // Coalesced requests are tagged with their op, so merges are counted per op.
+    future<size_t> read_at(uint64_t pos, char *buf, request_type op) {
+        if (_coalescer) {
+            return _coalescer->dma_read(pos, buf, req_size(), nullptr, unsigned(op));
+        }
+        return _file.dma_read(pos, buf, req_size(), _iop);
+    }
+
+    future<size_t> write_at(uint64_t pos, char *buf, request_type op) {
+        if (_coalescer) {
+            return _coalescer->dma_write(pos, buf, req_size(), nullptr, unsigned(op));
+        }
+        return _file.dma_write(pos, buf, req_size(), _iop);
+    }
+
+    uint64_t merged_requests(request_type op) const override {
+        if (!_coalescer) {
+            return 0;
+        }
+        return _coalescer->tag_stats(unsigned(op)).merged();
+    }
+
 public:
     io_class_data(job_config cfg) : class_data(std::move(cfg)) {
     }
 
     future<> do_start(sstring dir) override {
-        auto fname = format("{}/test-{}-{:d}", dir, name(), this_shard_id());
-        auto flags = open_flags::rw | open_flags::create | open_flags::truncate;
+        return open_file(dir).then([this] {
+            if (_config.options.coalesce_depth) {
+                _coalescer = std::make_unique<actor_apps_lib::coalescing_file>(_file, _config.options.coalesce_depth,
+                                                                               1 << 20, _iop);
+            }
+        });
+    }
+
+    future<> open_file(sstring dir) {
+        auto flags = open_flags::rw;
         if (_config.options.dsync) {
             flags |= open_flags::dsync;
         }
-        return open_file_dma(fname, flags)
+        // Shared files are created and filled by main() before any class starts.
+        if (!_config.options.shared_file.empty()) {
+            return open_file_dma(shared_file_name(dir, _config.options.shared_file), flags).then([this](auto f) {
+                _file = f;
+            });
+        }
+        auto fname = format("{}/test-{}-{:d}", dir, name(), this_shard_id());
+        return open_file_dma(fname, flags | open_flags::create | open_flags::truncate)
             .then([this, fname](auto f) {
                 _file = f;
                 return remove_file(fname);
             })
-            .then([this, fname] {
-                return do_with(nil::actor::semaphore(64), [this](auto &write_parallelism) mutable {
-                    auto bufsize = 256ul << 10;
-                    auto pos = boost::irange(0ul, (_config.file_size / bufsize) + 1);
-                    return parallel_for_each(
-                        pos.begin(), pos.end(), [this, bufsize, &write_parallelism](auto pos) mutable {
-                            return get_units(write_parallelism, 1).then([this, bufsize, pos](auto perm) mutable {
-                                auto bufptr = allocate_aligned_buffer<char>(bufsize, 4096);
-                                auto buf = bufptr.get();
-                                std::uniform_int_distribution<char> fill('@', '~');
-                                memset(buf, fill(random_generator), bufsize);
-                                pos = pos * bufsize;
-                                return _file.dma_write(pos, buf, bufsize)
-                                    .finally([this, bufptr = std::move(bufptr), perm = std::move(perm), pos] {
-                                        if ((this->req_type() == request_type::append) && (pos > _last_pos)) {
-                                            _last_pos = pos;
-                                        }
-                                    })
-                                    .discard_result();
-                            });
-                        });
-                });
-            })
-            .then([this] { return _file.flush(); });
+            .then([this] { return fill_file(_file, _config.file_size); })
+            .then([this] {
+                if (this->req_type() == request_type::append) {
+                    _last_pos[0] = (_config.file_size / fill_buffer_size) * fill_buffer_size;
+                }
+            });
     }
 
     virtual sstring describe_class() override {
-        return fmt::format("{}: {} shares, {}-byte {}, {}Mb file, {} concurrent requests, {}",
+        return fmt::format("{}: {} shares, {}-byte {}, {}Mb file, {}, {}",
                            name(),
                            shares(),
                            req_size(),
                            type_str(),
                            file_size_mb(),
-                           parallelism(),
+                           issue_mode(),
                            think_time());
     }
 
     virtual sstring describe_results() override {
-        auto throughput_kbs = (total_data() >> 10) / total_duration().count();
-        auto iops = requests() / total_duration().count();
-        sstring result;
-        result += fmt::format("  Throughput         : {:>8} KB/s\n", throughput_kbs);
-        result += fmt::format("  IOPS               : {:>8}\n", iops);
-        result += fmt::format("  Lat average        : {:>8} usec\n", average_latency());
-        for (auto &q : quantiles) {
-            result += fmt::format("  Lat quantile={:>5} : {:>8} usec\n", q, quantile_latency(q));
-        }
-        result += fmt::format("  Lat max            : {:>8} usec\n", max_latency());
-        return result;
+        return describe_ops(describe_io_results);
     }
 };
 
@@ -391,8 +939,8 @@ public:
     read_io_class_data(job_config cfg) : io_class_data(std::move(cfg)) {
     }
 
-    future<size_t> issue_request(char *buf) override {
-        return _file.dma_read(this->get_pos(), buf, this->req_size(), _iop);
+    future<size_t> issue_request(char *buf, request_type op) override {
+        return read_at(this->get_pos(op), buf, op);
     }
 };
 
@@ -401,8 +949,21 @@ public:
     write_io_class_data(job_config cfg) : io_class_data(std::move(cfg)) {
     }
 
-    future<size_t> issue_request(char *buf) override {
-        return _file.dma_write(this->get_pos(), buf, this->req_size(), _iop);
+    future<size_t> issue_request(char *buf, request_type op) override {
+        return write_at(this->get_pos(op), buf, op);
+    }
+};
+
+class mixed_io_class_data : public io_class_data {
+public:
+    mixed_io_class_data(job_config cfg) : io_class_data(std::move(cfg)) {
+    }
+
+    future<size_t> issue_request(char *buf, request_type op) override {
+        if (is_read(op)) {
+            return read_at(this->get_pos(op), buf, op);
+        }
+        return write_at(this->get_pos(op), buf, op);
     }
 };
 
@@ -415,7 +976,7 @@ public:
         return make_ready_future<>();
     }
 
-    future<size_t> issue_request(char *buf) override {
+    future<size_t> issue_request(char *buf, request_type op) override {
         // We do want the execution time to be a busy loop, and not just a bunch of
         // continuations until our time is up: by doing this we can also simulate the behavior
         // of I/O continuations in the face of reactor stalls.
@@ -427,24 +988,25 @@ public:
 
     virtual sstring describe_class() override {
         auto exec = std::chrono::duration_cast<std::chrono::microseconds>(_config.shard_info.execution_time);
-        return fmt::format("{}: {} shares, {} us CPU execution time, {} concurrent requests, {}",
+        return fmt::format("{}: {} shares, {} us CPU execution time, {}, {}",
                            name(),
                            shares(),
                            exec.count(),
-                           parallelism(),
+                           issue_mode(),
                            think_time());
     }
 
     virtual sstring describe_results() override {
-        auto throughput = total_data() / total_duration().count();
-        return fmt::format("  Throughput         : {:>8} continuations/s\n", throughput);
+        return describe_ops(describe_cpu_results);
     }
 };
 
 std::unique_ptr<class_data> job_config::gen_class_data() {
     if (type == request_type::cpu) {
         return std::make_unique<cpu_class_data>(*this);
-    } else if ((type == request_type::seqread) || (type == request_type::randread)) {
+    } else if (type == request_type::mixed) {
+        return std::make_unique<mixed_io_class_data>(*this);
+    } else if (is_read(type)) {
         return std::make_unique<read_io_class_data>(*this);
     } else {
         return std::make_unique<write_io_class_data>(*this);
@@ -453,25 +1015,6 @@ std::unique_ptr<class_data> job_config::gen_class_data() {
 
 /// YAML parsing functions
 namespace YAML {
-    template<>
-    struct convert<byte_size> {
-        static bool decode(const Node &node, byte_size &bs) {
-            auto str = node.as<std::string>();
-            unsigned shift = 0;
-            if (str.back() == 'B') {
-                str.pop_back();
-                shift = std::unordered_map<char, unsigned> {
-                    {'k', 10},
-                    {'M', 20},
-                    {'G', 30},
-                }[str.back()];
-                str.pop_back();
-            }
-            bs.size = (boost::lexical_cast<size_t>(str) << shift);
-            return bs.size >= 512;
-        }
-    };
-
     template<>
     struct convert<duration_time> {
         static bool decode(const Node &node, duration_time &dt) {
@@ -523,6 +1066,7 @@ namespace YAML {
                 {"seqread", request_type::seqread},   {"seqwrite", request_type::seqwrite},
                 {"randread", request_type::randread}, {"randwrite", request_type::randwrite},
                 {"append", request_type::append},     {"cpu", request_type::cpu},
+                {"mixed", request_type::mixed},
             };
             auto reqstr = node.as<std::string>();
             if (!mappings.count(reqstr)) {
@@ -544,6 +1088,10 @@ namespace YAML {
             }
             if (node["reqsize"]) {
                 sl.request_size = node["reqsize"].as<byte_size>().size;
+                if (sl.request_size < 512) {
+                    throw std::runtime_error(
+                        format("Request size of {} bytes is below the 512 byte minimum", sl.request_size));
+                }
             }
             if (node["think_time"]) {
                 sl.think_time = node["think_time"].as<duration_time>().time;
@@ -551,6 +1099,18 @@ namespace YAML {
             if (node["execution_time"]) {
                 sl.execution_time = node["execution_time"].as<duration_time>().time;
             }
+            if (node["latency_target"]) {
+                sl.latency_target = node["latency_target"].as<duration_time>().time;
+            }
+            if (node["rps"]) {
+                sl.rps = node["rps"].as<double>();
+            }
+            if (node["bandwidth"]) {
+                sl.bandwidth = node["bandwidth"].as<byte_size>().size;
+            }
+            if (open_loop_rate(sl) && rate_period(open_loop_rate(sl)) == std::chrono::steady_clock::duration::zero()) {
+                throw std::runtime_error(format("Rate of {:.0f} requests/s is too high to pace", open_loop_rate(sl)));
+            }
             return true;
         }
     };
@@ -561,6 +1121,15 @@ namespace YAML {
             if (node["dsync"]) {
                 op.dsync = node["dsync"].as<bool>();
             }
+            if (node["shared_file"]) {
+                op.shared_file = node["shared_file"].as<std::string>();
+            }
+            if (node["flush_every"]) {
+                op.flush_every = node["flush_every"].as<unsigned>();
+            }
+            if (node["coalesce_depth"]) {
+                op.coalesce_depth = node["coalesce_depth"].as<unsigned>();
+            }
             return true;
         }
     };
@@ -571,19 +1140,45 @@ namespace YAML {
             cl.name = node["name"].as<std::string>();
             cl.type = node["type"].as<request_type>();
             cl.shard_placement = node["shards"].as<shard_config>();
+            if (node["options"]) {
+                cl.options = node["options"].as<options>();
+            }
             // The data_size is used to divide the available (and effectively
             // constant) disk space between workloads. Each shard inside the
-            // workload thus uses its portion of the assigned space.
+            // workload thus uses its portion of the assigned space, unless
+            // all of them work on one shared file.
             if (node["data_size"]) {
-                cl.file_size = node["data_size"].as<byte_size>().size / smp::count;
+                cl.file_size = node["data_size"].as<byte_size>().size;
+                if (cl.file_size < 512) {
+                    throw std::runtime_error(
+                        format("Job {}: data_size of {} bytes is below the 512 byte minimum", cl.name, cl.file_size));
+                }
+                if (cl.options.shared_file.empty()) {
+                    cl.file_size /= smp::count;
+                }
             } else {
                 cl.file_size = 1ull << 30;    // 1G by default
             }
             if (node["shard_info"]) {
                 cl.shard_info = node["shard_info"].as<shard_info>();
             }
-            if (node["options"]) {
-                cl.options = node["options"].as<options>();
+            if (cl.type == request_type::mixed) {
+                if (!node["ratios"]) {
+                    throw std::runtime_error(format("Mixed job {} has no ratios", cl.name));
+                }
+                // Appends grow the file while the other types work within its fixed size, so a mixed
+                // class appending would move its reads and random writes onto a file of changing size.
+                for (auto it : node["ratios"]) {
+                    auto type = it.first.as<request_type>();
+                    if (type == request_type::append || type == request_type::cpu || type == request_type::mixed) {
+                        throw std::runtime_error(format("Job {}: {} can't be mixed", cl.name, request_type_name(type)));
+                    }
+                    cl.ratios.emplace_back(type, it.second.as<unsigned>());
+                }
+            }
+            if (!cl.options.shared_file.empty() && (cl.type == request_type::append || cl.type == request_type::cpu)) {
+                throw std::runtime_error(
+                    format("Job {}: {} jobs can't use a shared file", cl.name, request_type_name(cl.type)));
             }
             return true;
         }
@@ -594,6 +1189,7 @@ namespace YAML {
 /// run in this shard.
 class context {
     std::vector<std::unique_ptr<class_data>> _cl;
+    latency_governor _governor;
 
     sstring _dir;
     std::chrono::seconds _duration;
@@ -607,9 +1203,16 @@ public:
             boost::adaptors::filtered([](auto &cfg) { return cfg.shard_placement.is_set(this_shard_id()); }) |
             boost::adaptors::transformed([](auto &cfg) { return cfg.gen_class_data(); }))),
         _dir(dir), _duration(duration), _finished(0) {
+        for (auto &cl : _cl) {
+            cl->set_latency_target(_governor);
+        }
+        for (auto &cl : _cl) {
+            cl->set_throttled(_governor);
+        }
     }
 
     future<> stop() {
+        _governor.stop();
         return parallel_for_each(_cl, [](std::unique_ptr<class_data> &cl) { return cl->stop(); });
     }
 
@@ -618,6 +1221,7 @@ public:
     }
 
     future<> issue_requests() {
+        _governor.start();
         return parallel_for_each(_cl.begin(), _cl.end(), [this](std::unique_ptr<class_data> &cl) {
             return cl->issue_requests(std::chrono::steady_clock::now() + _duration).finally([this] {
                 _finished.signal(1);
@@ -625,6 +1229,22 @@ public:
         });
     }
 
+    std::vector<class_stats> stats() const {
+        std::vector<class_stats> res;
+        for (auto &cl : _cl) {
+            res = concat_class_stats(std::move(res), cl->stats());
+        }
+        return res;
+    }
+
+    std::vector<class_stats> take_interval() {
+        std::vector<class_stats> res;
+        for (auto &cl : _cl) {
+            res = concat_class_stats(std::move(res), cl->take_interval());
+        }
+        return res;
+    }
+
     future<> print_stats() {
         return _finished.wait(_cl.size()).then([this] {
             fmt::print("Shard {:>2}\n", this_shard_id());
@@ -643,6 +1263,156 @@ int class_data::idgen() {
     return id++;
 }
 
+struct interval_report {
+    std::chrono::duration<float> elapsed;
+    std::vector<class_stats> classes;
+};
+
+void print_interval(const interval_report &report) {
+    for (auto &st : report.classes) {
+        fmt::print("{:>7.1f}s {:>16}: {:>10.0f} KB/s {:>8.0f} IOPS, lat p50 {:>7} p99 {:>7} max {:>7} usec\n",
+                   report.elapsed.count(), st.label(), st.throughput_kbs(), st.iops(), st.latencies.quantile(0.5),
+                   st.latencies.quantile(0.99), st.latencies.max());
+    }
+}
+
+void emit_latencies(YAML::Emitter &out, const char *key, const actor_apps_lib::latency_histogram &latencies) {
+    out << YAML::Key << key << YAML::Value << YAML::BeginMap;
+    out << YAML::Key << "average" << YAML::Value << latencies.mean();
+    for (auto &q : quantiles) {
+        out << YAML::Key << fmt::format("p{}", q) << YAML::Value << latencies.quantile(q);
+    }
+    out << YAML::Key << "max" << YAML::Value << latencies.max();
+    out << YAML::EndMap;
+}
+
+void emit_class_stats(YAML::Emitter &out, const class_stats &st) {
+    out << YAML::BeginMap;
+    out << YAML::Key << "name" << YAML::Value << st.name;
+    out << YAML::Key << "op" << YAML::Value << st.op;
+    out << YAML::Key << "shards" << YAML::Value << st.shards;
+    out << YAML::Key << "duration" << YAML::Value << st.duration.count();
+    out << YAML::Key << "requests" << YAML::Value << st.requests;
+    out << YAML::Key << "merged_requests" << YAML::Value << st.merged;
+    out << YAML::Key << "dropped_requests" << YAML::Value << st.dropped;
+    out << YAML::Key << "bytes" << YAML::Value << st.data;
+    out << YAML::Key << "throughput_kbs" << YAML::Value << st.throughput_kbs();
+    out << YAML::Key << "iops" << YAML::Value << st.iops();
+    emit_latencies(out, "latencies_usec", st.latencies);
+    if (st.queue_latencies.count()) {
+        emit_latencies(out, "queue_latencies_usec", st.queue_latencies);
+    }
+    if (st.disk_latencies.count()) {
+        emit_latencies(out, "disk_latencies_usec", st.disk_latencies);
+    }
+    out << YAML::EndMap;
+}
+
+template<typename T>
+std::string join_values(const std::vector<T> &values) {
+    std::string res;
+    for (auto &v : values) {
+        res += (res.empty() ? "" : " ") + boost::lexical_cast<std::string>(v);
+    }
+    return res;
+}
+
+// Parsed options of the run, reactor ones included, so that results of the same configuration
+// under different I/O backends or reactor settings can be told apart. Options of types without
+// a text form here, such as cpusets, are described as "?"; the command line recorded next to them
+// has them verbatim.
+std::map<std::string, std::string> describe_options(const boost::program_options::variables_map &opts) {
+    std::map<std::string, std::string> res;
+    for (auto &opt : opts) {
+        auto &value = opt.second.value();
+        if (auto v = boost::any_cast<sstring>(&value)) {
+            res[opt.first] = *v;
+        } else if (auto v = boost::any_cast<std::string>(&value)) {
+            res[opt.first] = *v;
+        } else if (auto v = boost::any_cast<unsigned>(&value)) {
+            res[opt.first] = std::to_string(*v);
+        } else if (auto v = boost::any_cast<int>(&value)) {
+            res[opt.first] = std::to_string(*v);
+        } else if (auto v = boost::any_cast<double>(&value)) {
+            res[opt.first] = std::to_string(*v);
+        } else if (auto v = boost::any_cast<float>(&value)) {
+            res[opt.first] = std::to_string(*v);
+        } else if (auto v = boost::any_cast<bool>(&value)) {
+            res[opt.first] = *v ? "true" : "false";
+        } else if (auto v = boost::any_cast<unsigned long>(&value)) {
+            res[opt.first] = std::to_string(*v);
+        } else if (auto v = boost::any_cast<unsigned long long>(&value)) {
+            res[opt.first] = std::to_string(*v);
+        } else if (auto v = boost::any_cast<long>(&value)) {
+            res[opt.first] = std::to_string(*v);
+        } else if (auto v = boost::any_cast<std::vector<sstring>>(&value)) {
+            res[opt.first] = join_values(*v);
+        } else if (auto v = boost::any_cast<std::vector<std::string>>(&value)) {
+            res[opt.first] = join_values(*v);
+        } else if (auto v = boost::any_cast<std::vector<unsigned>>(&value)) {
+            res[opt.first] = join_values(*v);
+        } else {
+            res[opt.first] = "?";
+        }
+    }
+    return res;
+}
+
+// Writes merged and per-shard results plus the timeline. JSON is produced by the same
+// emitter in flow style with quoted strings, which is valid JSON.
+void write_results(sstring file, sstring format, const std::vector<std::string> &command_line,
+                   const std::map<std::string, std::string> &options,
+                   const std::vector<class_stats> &merged, const std::vector<class_stats> &per_shard,
+                   const std::vector<interval_report> &timeline) {
+    YAML::Emitter out;
+    if (format == "json") {
+        out.SetMapFormat(YAML::Flow);
+        out.SetSeqFormat(YAML::Flow);
+        out.SetStringFormat(YAML::DoubleQuoted);
+    }
+    out << YAML::BeginMap;
+    out << YAML::Key << "command_line" << YAML::Value << YAML::BeginSeq;
+    for (auto &arg : command_line) {
+        out << arg;
+    }
+    out << YAML::EndSeq;
+    out << YAML::Key << "options" << YAML::Value << YAML::BeginMap;
+    for (auto &opt : options) {
+        out << YAML::Key << opt.first << YAML::Value << opt.second;
+    }
+    out << YAML::EndMap;
+    out << YAML::Key << "classes" << YAML::Value << YAML::BeginSeq;
+    for (auto &st : merged) {
+        emit_class_stats(out, st);
+    }
+    out << YAML::EndSeq;
+    out << YAML::Key << "shards" << YAML::Value << YAML::BeginSeq;
+    for (auto &st : per_shard) {
+        emit_class_stats(out, st);
+    }
+    out << YAML::EndSeq;
+    out << YAML::Key << "timeline" << YAML::Value << YAML::BeginSeq;
+    for (auto &report : timeline) {
+        out << YAML::BeginMap;
+        out << YAML::Key << "elapsed" << YAML::Value << report.elapsed.count();
+        out << YAML::Key << "classes" << YAML::Value << YAML::BeginSeq;
+        for (auto &st : report.classes) {
+            emit_class_stats(out, st);
+        }
+        out << YAML::EndSeq;
+        out << YAML::EndMap;
+    }
+    out << YAML::EndSeq;
+    out << YAML::EndMap;
+    out << YAML::Newline;
+
+    std::ofstream of(file);
+    of << out.c_str();
+    if (!of) {
+        throw std::runtime_error(format("Can't write results to {}", file));
+    }
+}
+
 int main(int ac, char **av) {
     namespace bpo = boost::program_options;
 
@@ -650,7 +1420,11 @@ int main(int ac, char **av) {
     auto opt_add = app.add_options();
     opt_add("directory", bpo::value<sstring>()->default_value("."), "directory where to execute the test")(
         "duration", bpo::value<unsigned>()->default_value(10), "for how long (in seconds) to run the test")(
-        "conf", bpo::value<sstring>()->default_value("./conf.yaml"), "YAML file containing benchmark specification");
+        "conf", bpo::value<sstring>()->default_value("./conf.yaml"), "YAML file containing benchmark specification")(
+        "report-interval", bpo::value<unsigned>()->default_value(0),
+        "print throughput and latencies merged across shards every this many seconds (0 to disable)")(
+        "output-file", bpo::value<sstring>(), "write machine-readable results to this file")(
+        "output-format", bpo::value<sstring>()->default_value("json"), "format of --output-file (json | yaml)");
 
     distributed<context> ctx;
     return app.run(ac, av, [&] {
@@ -664,6 +1438,11 @@ int main(int ac, char **av) {
                    }
 
                    auto &duration = opts["duration"].as<unsigned>();
+                   auto report_interval = std::chrono::seconds(opts["report-interval"].as<unsigned>());
+                   auto &output_format = opts["output-format"].as<sstring>();
+                   if (output_format != "json" && output_format != "yaml") {
+                       throw std::runtime_error(format("Unknown output format {}", output_format));
+                   }
                    auto &yaml = opts["conf"].as<sstring>();
                    YAML::Node doc = YAML::LoadFile(yaml);
                    auto reqs = doc.as<std::vector<job_config>>();
@@ -673,15 +1452,78 @@ int main(int ac, char **av) {
                            .then([&r](nil::actor::scheduling_group sg) { r.shard_info.scheduling_group = sg; });
                    }).get();
 
+                   // Every shared file is filled once, large enough for the biggest job using it.
+                   std::unordered_map<std::string, uint64_t> shared_files;
+                   for (auto &r : reqs) {
+                       if (!r.options.shared_file.empty()) {
+                           auto &size = shared_files[r.options.shared_file];
+                           size = std::max(size, r.file_size);
+                       }
+                   }
+                   // removed whether the run succeeds or not; ones never created are ignored
+                   auto remove_shared_files = nil::actor::defer([&] {
+                       for (auto &sf : shared_files) {
+                           remove_file(shared_file_name(directory, sf.first))
+                               .handle_exception([](std::exception_ptr) {})
+                               .get();
+                       }
+                   });
+                   if (!shared_files.empty()) {
+                       std::cout << "Creating shared files..." << std::endl;
+                   }
+                   for (auto &sf : shared_files) {
+                       auto f = open_file_dma(shared_file_name(directory, sf.first),
+                                              open_flags::rw | open_flags::create | open_flags::truncate)
+                                    .get0();
+                       fill_file(f, sf.second).get();
+                       f.close().get();
+                   }
+
                    ctx.start(directory, reqs, duration).get0();
                    engine().at_exit([&ctx] { return ctx.stop(); });
                    std::cout << "Creating initial files..." << std::endl;
                    ctx.invoke_on_all([](auto &c) { return c.start(); }).get();
                    std::cout << "Starting evaluation..." << std::endl;
-                   ctx.invoke_on_all([](auto &c) { return c.issue_requests(); }).get();
+                   auto started = std::chrono::steady_clock::now();
+                   auto issued = ctx.invoke_on_all([](auto &c) { return c.issue_requests(); });
+                   std::vector<interval_report> timeline;
+                   if (report_interval.count()) {
+                       auto end = started + std::chrono::seconds(duration);
+                       for (auto next = started + report_interval; next <= end && !issued.available();
+                            next += report_interval) {
+                           nil::actor::sleep(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                 next - std::chrono::steady_clock::now()))
+                               .get();
+                           interval_report report;
+                           report.elapsed = std::chrono::steady_clock::now() - started;
+                           report.classes = merge_class_stats(
+                               ctx.map_reduce0([](auto &c) { return c.take_interval(); },
+                                               std::vector<class_stats>(), concat_class_stats)
+                                   .get0());
+                           print_interval(report);
+                           timeline.push_back(std::move(report));
+                       }
+                   }
+                   issued.get();
                    for (unsigned i = 0; i < smp::count; ++i) {
                        ctx.invoke_on(i, [](auto &c) { return c.print_stats(); }).get();
                    }
+
+                   auto per_shard =
+                       ctx.map_reduce0([](auto &c) { return c.stats(); }, std::vector<class_stats>(), concat_class_stats)
+                           .get0();
+                   auto merged = merge_class_stats(per_shard);
+                   fmt::print("All shards\n");
+                   for (auto &st : merged) {
+                       fmt::print("Class {} ({} shards)\n", st.label(), st.shards);
+                       fmt::print("{}\n", st.type == request_type::cpu ? describe_cpu_results(st)
+                                                                       : describe_io_results(st));
+                   }
+                   if (opts.count("output-file")) {
+                       write_results(opts["output-file"].as<sstring>(), output_format,
+                                     std::vector<std::string>(av, av + ac), describe_options(opts), merged,
+                                     per_shard, timeline);
+                   }
                    ctx.stop().get0();
                })
             .or_terminate();
@@ -32,10 +32,13 @@
 #include <memory>
 #include <vector>
 #include <cmath>
+#include <map>
+#include <numeric>
 #include <sys/vfs.h>
 #include <sys/sysmacros.h>
 
 #include <boost/filesystem.hpp>
+#include <boost/algorithm/string.hpp>
 #include <boost/range/irange.hpp>
 #include <boost/program_options.hpp>
 #include <boost/iterator/counting_iterator.hpp>
@@ -57,11 +60,14 @@
 #include <nil/actor/core/shared_ptr.hh>
 #include <nil/actor/core/fsqual.hh>
 #include <nil/actor/core/loop.hh>
+#include <nil/actor/core/sleep.hh>
 #include <nil/actor/detail/defer.hh>
 #include <nil/actor/detail/log.hh>
 #include <nil/actor/detail/std-compat.hh>
 #include <nil/actor/detail/read_first_line.hh>
 
+#include "../lib/latency_histogram.hh"
+
 using namespace nil::actor;
 using namespace std::chrono_literals;
 namespace fs = boost::filesystem;
@@ -111,6 +117,37 @@ struct evaluation_directory {
     uint64_t _available_space;
     uint64_t _min_data_transfer_size = 512;
     unsigned _disks_per_array = 0;
+    // "model:identity" of every disk backing the directory; empty if any of them can't be identified
+    std::vector<std::string> _disk_ids;
+    bool _unidentified_disk = false;
+
+    static std::string read_trimmed(const boost::filesystem::path &file) {
+        if (!boost::filesystem::exists(file)) {
+            return "";
+        }
+        return boost::algorithm::trim_copy(std::string(read_first_line(file)));
+    }
+
+    // Identifies the disk by its serial number, or else by its world wide identifier, which some
+    // drivers report instead. Disks with neither are told apart by model and capacity only, which
+    // is enough to reuse the results of an identical disk.
+    void identify_disk(boost::filesystem::path sys_file) {
+        auto dev_dir = sys_file / "device";
+        auto model = read_trimmed(dev_dir / "model");
+        for (auto id : {dev_dir / "serial", dev_dir / "wwid", sys_file / "wwid"}) {
+            auto value = read_trimmed(id);
+            if (!value.empty()) {
+                _disk_ids.push_back(model + ":" + value);
+                return;
+            }
+        }
+        auto sectors = read_trimmed(sys_file / "size");
+        if (model.empty() || sectors.empty()) {
+            _unidentified_disk = true;
+            return;
+        }
+        _disk_ids.push_back(model + ":sectors=" + sectors);
+    }
 
     void scan_device(unsigned dev_maj, unsigned dev_min) {
         scan_device(fmt::format("{}:{}", dev_maj, dev_min));
@@ -140,6 +177,7 @@ struct evaluation_directory {
                 scan_device(sys_file.remove_filename());
             } else {
                 check_device_properties(sys_file);
+                identify_disk(sys_file);
                 auto queue_dir = sys_file / "queue";
                 auto disk_min_io_size = read_first_line_as<uint64_t>(queue_dir / "minimum_io_size");
 
@@ -179,6 +217,17 @@ public:
         return _min_data_transfer_size;
     }
 
+    // Identifies the device(s) backing the directory, so results can be reused for identical ones.
+    // Returns an empty string when sysfs doesn't tell.
+    std::string device_id() const {
+        if (_unidentified_disk || _disk_ids.empty()) {
+            return "";
+        }
+        auto ids = _disk_ids;
+        std::sort(ids.begin(), ids.end());
+        return boost::algorithm::join(ids, ",");
+    }
+
     future<> discover_directory() {
         return nil::actor::async([this] {
             auto f = open_directory(_name).get0();
@@ -197,17 +246,31 @@ public:
 struct io_rates {
     float bytes_per_sec = 0;
     float iops = 0;
+    // request latencies, in microseconds
+    actor_apps_lib::latency_histogram latencies;
+
     io_rates operator+(const io_rates &a) const {
-        return io_rates {bytes_per_sec + a.bytes_per_sec, iops + a.iops};
+        return io_rates {bytes_per_sec + a.bytes_per_sec, iops + a.iops, latencies + a.latencies};
     }
 
     io_rates &operator+=(const io_rates &a) {
         bytes_per_sec += a.bytes_per_sec;
         iops += a.iops;
+        latencies += a.latencies;
         return *this;
     }
 };
 
+// Reads and writes of a workload running both at the same time.
+struct interference_rates {
+    io_rates reads;
+    io_rates writes;
+
+    interference_rates operator+(const interference_rates &a) const {
+        return interference_rates {reads + a.reads, writes + a.writes};
+    }
+};
+
 class invalid_position : public std::exception {
 public:
     virtual const char *what() const noexcept {
@@ -302,17 +365,35 @@ public:
     }
 };
 
+class mixed_request_issuer : public request_issuer {
+    file _file;
+    std::bernoulli_distribution _is_read;
+
+public:
+    mixed_request_issuer(file f, double read_fraction) : _file(f), _is_read(read_fraction) {
+    }
+    future<size_t> issue_request(uint64_t pos, char *buf, uint64_t size) override {
+        if (_is_read(random_generator)) {
+            return _file.dma_read(pos, buf, size);
+        }
+        return _file.dma_write(pos, buf, size);
+    }
+};
+
 class io_worker {
     uint64_t _bytes = 0;
     uint64_t _max_offset = 0;
     unsigned _requests = 0;
+    actor_apps_lib::latency_histogram _latencies;
     size_t _buffer_size;
     std::chrono::time_point<iotune_clock, std::chrono::duration<double>> _start_measuring;
     std::chrono::time_point<iotune_clock, std::chrono::duration<double>> _end_measuring;
     std::chrono::time_point<iotune_clock, std::chrono::duration<double>> _end_load;
     // track separately because in the sequential case we may exhaust the file before _duration
     std::chrono::time_point<iotune_clock, std::chrono::duration<double>> _last_time_seen;
-
+    // requests per second the worker is paced to, or 0 to issue them as fast as possible
+    double _rate = 0;
+    uint64_t _paced = 0;
     std::unique_ptr<position_generator> _pos_impl;
     std::unique_ptr<request_issuer> _req_impl;
 
@@ -333,19 +414,52 @@ public:
         _last_time_seen(_start_measuring), _pos_impl(std::move(pos)), _req_impl(std::move(reqs)) {
     }
 
+    // Ends the measurement, and the load, at the given time if it is earlier than planned.
+    void stop_at(std::chrono::time_point<iotune_clock, std::chrono::duration<double>> t) {
+        _end_measuring = std::min(_end_measuring, t);
+        _end_load = std::min(_end_load, t);
+    }
+
+    uint64_t measured_bytes() const noexcept {
+        return _bytes;
+    }
+
+    bool paced() const {
+        return _rate;
+    }
+
+    void set_rate(double requests_per_sec) {
+        _rate = requests_per_sec;
+    }
+
+    // Delays the next request until it is due at the configured rate.
+    future<> pace() {
+        if (!_rate) {
+            return make_ready_future<>();
+        }
+        auto due = _start_measuring - 10ms + std::chrono::duration<double>(_paced++ / _rate);
+        auto now = iotune_clock::now();
+        if (due <= now) {
+            return make_ready_future<>();
+        }
+        return nil::actor::sleep(std::chrono::duration_cast<std::chrono::microseconds>(due - now));
+    }
+
     std::unique_ptr<char[], free_deleter> get_buffer() {
         return allocate_aligned_buffer<char>(_buffer_size, _buffer_size);
     }
 
     future<> issue_request(char *buf) {
         uint64_t pos = _pos_impl->get_pos();
-        return _req_impl->issue_request(pos, buf, _buffer_size).then([this, pos](size_t size) {
+        auto start = iotune_clock::now();
+        return _req_impl->issue_request(pos, buf, _buffer_size).then([this, pos, start](size_t size) {
             auto now = iotune_clock::now();
             _max_offset = std::max(_max_offset, pos + size);
             if ((now > _start_measuring) && (now < _end_measuring)) {
                 _last_time_seen = now;
                 _bytes += size;
                 _requests++;
+                _latencies.record(std::chrono::duration_cast<std::chrono::microseconds>(now - start).count());
             }
         });
     }
@@ -362,6 +476,7 @@ public:
         }
         rates.bytes_per_sec = _bytes / t.count();
         rates.iops = _requests / t.count();
+        rates.latencies = _latencies;
         return rates;
     }
 };
@@ -373,6 +488,8 @@ public:
 private:
     boost::filesystem::path _dirpath;
     uint64_t _file_size;
+    // workers running on this shard, so a measurement can be ended early
+    std::vector<io_worker *> _workers;
     file _file;
 
     std::unique_ptr<position_generator> get_position_generator(size_t buffer_size, pattern access_pattern) {
@@ -389,6 +506,23 @@ public:
         _file_size(maximum_size) {
     }
 
+    // Bytes measured so far by the running workers, paced ones excepted: they only generate load.
+    uint64_t measured_bytes() const {
+        uint64_t bytes = 0;
+        for (auto w : _workers) {
+            if (!w->paced()) {
+                bytes += w->measured_bytes();
+            }
+        }
+        return bytes;
+    }
+
+    void stop_at(std::chrono::time_point<iotune_clock, std::chrono::duration<double>> t) {
+        for (auto w : _workers) {
+            w->stop_at(t);
+        }
+    }
+
     future<> create_data_file() {
         // XFS likes access in many directories better.
         return make_directory(_dirpath.string()).then([this] {
@@ -411,16 +545,21 @@ public:
         }
 
         auto worker = worker_ptr.get();
+        _workers.push_back(worker);
         auto concurrency = boost::irange<unsigned, unsigned>(0, max_os_concurrency, 1);
         return parallel_for_each(std::move(concurrency),
                                  [worker](unsigned idx) {
                                      auto bufptr = worker->get_buffer();
                                      auto buf = bufptr.get();
                                      return do_until([worker] { return worker->should_stop(); },
-                                                     [buf, worker] { return worker->issue_request(buf); })
+                                                     [buf, worker] {
+                                                         return worker->pace().then(
+                                                             [buf, worker] { return worker->issue_request(buf); });
+                                                     })
                                          .finally([alive = std::move(bufptr)] {});
                                  })
             .then_wrapped([this, worker = std::move(worker_ptr), update_file_size](future<> f) {
+                _workers.erase(std::find(_workers.begin(), _workers.end(), worker.get()));
                 try {
                     f.get();
                 } catch (invalid_position &ip) {
@@ -457,6 +596,46 @@ public:
         });
     }
 
+    // Random reads while a sequential writer paced to write_bytes_per_sec overwrites the same file.
+    future<interference_rates> read_under_write_workload(size_t read_size, unsigned read_concurrency,
+                                                         size_t write_size, unsigned write_concurrency,
+                                                         double write_bytes_per_sec,
+                                                         std::chrono::duration<double> duration) {
+        read_size = std::max(read_size, _file.disk_read_dma_alignment());
+        write_size = std::max(write_size, _file.disk_write_dma_alignment());
+        auto writer = std::make_unique<io_worker>(write_size, duration, std::make_unique<write_request_issuer>(_file),
+                                                  get_position_generator(write_size, pattern::sequential));
+        writer->set_rate(write_bytes_per_sec / write_size);
+        auto reader = std::make_unique<io_worker>(read_size, duration, std::make_unique<read_request_issuer>(_file),
+                                                  get_position_generator(read_size, pattern::random));
+        // The writer wraps around within the file, so the file size is left alone.
+        auto writes = do_workload(std::move(writer), write_concurrency);
+        return do_workload(std::move(reader), read_concurrency)
+            .then([writes = std::move(writes)](io_rates reads) mutable {
+                return writes.then([reads = std::move(reads)](io_rates writes) mutable {
+                    return interference_rates {std::move(reads), std::move(writes)};
+                });
+            })
+            .then([this](interference_rates r) {
+                return _file.flush().then([r = std::move(r)]() mutable {
+                    return make_ready_future<interference_rates>(std::move(r));
+                });
+            });
+    }
+
+    // Random reads and writes on the same file, read_fraction of them being reads.
+    future<io_rates> mixed_workload(size_t buffer_size, double read_fraction, unsigned max_os_concurrency,
+                                    std::chrono::duration<double> duration) {
+        buffer_size = std::max({buffer_size, _file.disk_read_dma_alignment(), _file.disk_write_dma_alignment()});
+        auto worker = std::make_unique<io_worker>(buffer_size, duration,
+                                                  std::make_unique<mixed_request_issuer>(_file, read_fraction),
+                                                  get_position_generator(buffer_size, pattern::random));
+        return do_workload(std::move(worker), max_os_concurrency).then([this](io_rates r) {
+            return _file.flush().then(
+                [r = std::move(r)]() mutable { return make_ready_future<io_rates>(std::move(r)); });
+        });
+    }
+
     future<> stop() {
         return _file.close();
     }
@@ -464,6 +643,7 @@ public:
 
 class iotune_multi_shard_context {
     ::evaluation_directory _test_directory;
+    std::optional<double> _tolerance;
 
     unsigned per_shard_io_depth() const {
         auto iodepth = _test_directory.max_iodepth() / smp::count;
@@ -472,8 +652,85 @@ class iotune_multi_shard_context {
         }
         return std::min(iodepth, 128u);
     }
+    // Splits a total concurrency between shards the same way per_shard_io_depth() splits the queue depth.
+    static unsigned per_shard_share(unsigned total) {
+        auto share = total / smp::count;
+        if (this_shard_id() < total % smp::count) {
+            share++;
+        }
+        return share;
+    }
     nil::actor::sharded<test_file> _iotune_test_file;
 
+    static constexpr auto sample_window = 100ms;
+    static constexpr size_t min_windows = 5;
+
+    struct convergence_state {
+        bool done = false;
+        uint64_t last_bytes = 0;
+        iotune_clock::time_point last_time;
+        // throughput of every sample window, all shards together
+        std::vector<double> rates;
+    };
+
+    // Whether the 95% confidence interval of the mean of the rates is within tolerance of it.
+    static bool converged(const std::vector<double> &rates, double tolerance) {
+        auto n = rates.size();
+        if (n < min_windows) {
+            return false;
+        }
+        auto mean = std::accumulate(rates.begin(), rates.end(), 0.0) / n;
+        auto sq = std::accumulate(rates.begin(), rates.end(), 0.0,
+                                  [mean](double acc, double r) { return acc + (r - mean) * (r - mean); });
+        auto half_width = 1.96 * std::sqrt(sq / (n - 1)) / std::sqrt(n);
+        return half_width <= tolerance * mean;
+    }
+
+    future<> sample(lw_shared_ptr<convergence_state> st) {
+        return _iotune_test_file
+            .map_reduce0([](test_file &tf) { return tf.measured_bytes(); }, uint64_t(0), std::plus<uint64_t>())
+            .then([this, st](uint64_t bytes) {
+                auto now = iotune_clock::now();
+                // nothing measured yet, or workers already finishing
+                if (st->done || !bytes || bytes < st->last_bytes) {
+                    return make_ready_future<>();
+                }
+                if (st->last_bytes) {
+                    st->rates.push_back((bytes - st->last_bytes) /
+                                        std::chrono::duration<double>(now - st->last_time).count());
+                }
+                st->last_bytes = bytes;
+                st->last_time = now;
+                if (!converged(st->rates, *_tolerance)) {
+                    return make_ready_future<>();
+                }
+                st->done = true;
+                return _iotune_test_file.invoke_on_all([now](test_file &tf) { tf.stop_at(now); });
+            });
+    }
+
+    // With --adaptive, samples the throughput of all shards together every sample_window while the
+    // measurement runs, and once it has converged ends the measurement on every shard at the same
+    // time, so the rates summed across shards cover the same interval.
+    template<typename T>
+    future<T> converging(future<T> measurement) {
+        if (!_tolerance) {
+            return measurement;
+        }
+        auto st = make_lw_shared<convergence_state>();
+        auto poller = do_until([st] { return st->done; }, [this, st] {
+            return nil::actor::sleep(sample_window).then([this, st] { return sample(st); });
+        });
+        return std::move(measurement)
+            .finally([st] { st->done = true; })
+            .then_wrapped([poller = std::move(poller)](future<T> f) mutable {
+                return std::move(poller).then_wrapped([f = std::move(f)](future<> p) mutable {
+                    p.ignore_ready_future();
+                    return std::move(f);
+                });
+            });
+    }
+
 public:
     future<> stop() {
         return _iotune_test_file.stop();
@@ -487,6 +744,8 @@ public:
         return _iotune_test_file.invoke_on_all([](test_file &tf) { return tf.create_data_file(); });
     }
 
+    // Not stopped early: the data it writes is what the read measurements that follow read, so it
+    // has to run for its whole duration.
     future<io_rates> write_sequential_data(unsigned shard, size_t buffer_size, std::chrono::duration<double> duration) {
         return _iotune_test_file.invoke_on(shard, [this, buffer_size, duration](test_file &tf) {
             return tf.write_workload(buffer_size, test_file::pattern::sequential, 4 * _test_directory.disks_per_array(),
@@ -495,38 +754,164 @@ public:
     }
 
     future<io_rates> read_sequential_data(unsigned shard, size_t buffer_size, std::chrono::duration<double> duration) {
-        return _iotune_test_file.invoke_on(shard, [this, buffer_size, duration](test_file &tf) {
+        return converging(_iotune_test_file.invoke_on(shard, [this, buffer_size, duration](test_file &tf) {
             return tf.read_workload(buffer_size, test_file::pattern::sequential, 4 * _test_directory.disks_per_array(),
                                     duration);
-        });
+        }));
     }
 
     future<io_rates> write_random_data(size_t buffer_size, std::chrono::duration<double> duration) {
-        return _iotune_test_file.map_reduce0(
+        return converging(_iotune_test_file.map_reduce0(
             [buffer_size, this, duration](test_file &tf) {
                 return tf.write_workload(buffer_size, test_file::pattern::random, per_shard_io_depth(), duration);
             },
-            io_rates(), std::plus<io_rates>());
+            io_rates(), std::plus<io_rates>()));
     }
 
     future<io_rates> read_random_data(size_t buffer_size, std::chrono::duration<double> duration) {
-        return _iotune_test_file.map_reduce0(
+        return converging(_iotune_test_file.map_reduce0(
             [buffer_size, this, duration](test_file &tf) {
                 return tf.read_workload(buffer_size, test_file::pattern::random, per_shard_io_depth(), duration);
             },
-            io_rates(), std::plus<io_rates>());
+            io_rates(), std::plus<io_rates>()));
     }
 
-    iotune_multi_shard_context(::evaluation_directory dir) : _test_directory(dir) {
+    // The variants below issue `concurrency` requests in total across all shards; shards whose share is
+    // zero stay idle.
+    future<io_rates> read_random_data(size_t buffer_size, std::chrono::duration<double> duration,
+                                      unsigned concurrency) {
+        return converging(_iotune_test_file.map_reduce0(
+            [buffer_size, duration, concurrency](test_file &tf) {
+                auto share = per_shard_share(concurrency);
+                return share ? tf.read_workload(buffer_size, test_file::pattern::random, share, duration)
+                             : make_ready_future<io_rates>();
+            },
+            io_rates(), std::plus<io_rates>()));
+    }
+
+    future<io_rates> write_random_data(size_t buffer_size, std::chrono::duration<double> duration,
+                                       unsigned concurrency) {
+        return converging(_iotune_test_file.map_reduce0(
+            [buffer_size, duration, concurrency](test_file &tf) {
+                auto share = per_shard_share(concurrency);
+                return share ? tf.write_workload(buffer_size, test_file::pattern::random, share, duration)
+                             : make_ready_future<io_rates>();
+            },
+            io_rates(), std::plus<io_rates>()));
+    }
+
+    future<io_rates> mixed_random_data(size_t buffer_size, double read_fraction, std::chrono::duration<double> duration,
+                                       unsigned concurrency) {
+        return converging(_iotune_test_file.map_reduce0(
+            [buffer_size, read_fraction, duration, concurrency](test_file &tf) {
+                auto share = per_shard_share(concurrency);
+                return share ? tf.mixed_workload(buffer_size, read_fraction, share, duration)
+                             : make_ready_future<io_rates>();
+            },
+            io_rates(), std::plus<io_rates>()));
+    }
+
+    // Random reads at full depth on every shard, while every shard also writes sequentially at its
+    // share of write_bytes_per_sec.
+    future<interference_rates> read_under_write(size_t read_size, size_t write_size, double write_bytes_per_sec,
+                                                std::chrono::duration<double> duration) {
+        return converging(_iotune_test_file.map_reduce0(
+            [this, read_size, write_size, write_bytes_per_sec, duration](test_file &tf) {
+                return tf.read_under_write_workload(read_size, per_shard_io_depth(), write_size,
+                                                    4 * _test_directory.disks_per_array(),
+                                                    write_bytes_per_sec / smp::count, duration);
+            },
+            interference_rates(), std::plus<interference_rates>()));
+    }
+
+    iotune_multi_shard_context(::evaluation_directory dir, std::optional<double> tolerance) :
+        _test_directory(dir), _tolerance(tolerance) {
     }
 };
 
+struct sweep_point {
+    unsigned concurrency;
+    io_rates rates;
+
+    // Kleinrock's power: throughput over latency. It grows while added concurrency turns into
+    // throughput and falls once it only turns into queueing, so its maximum is the knee of the curve.
+    double power() const {
+        return rates.iops / std::max(rates.latencies.mean(), 1.0);
+    }
+};
+
+struct sweep_curve {
+    size_t request_size;
+    std::vector<sweep_point> points;
+    size_t knee = 0;
+
+    void add(sweep_point p) {
+        points.push_back(std::move(p));
+        if (points.back().power() > points[knee].power()) {
+            knee = points.size() - 1;
+        }
+    }
+
+    // Two steps past the best point are enough to tell the device is saturated.
+    bool saturated() const {
+        return points.size() >= knee + 3;
+    }
+
+    const sweep_point &knee_point() const {
+        return points[knee];
+    }
+};
+
+// Doubles the concurrency from 1 up to max_concurrency, stopping early once past the knee.
+// Must run in a thread.
+sweep_curve sweep(sstring what, size_t request_size, unsigned max_concurrency,
+                  std::function<future<io_rates>(unsigned)> workload) {
+    sweep_curve curve;
+    curve.request_size = request_size;
+    fmt::print("Sweeping {} {}-byte requests:\n", what, request_size);
+    for (unsigned concurrency = 1; concurrency <= max_concurrency && !curve.saturated(); concurrency *= 2) {
+        auto rates = workload(concurrency).get0();
+        fmt::print("  {:>5} in flight: {:>9} IOPS {:>7} MB/s, lat p50 {:>7} p99 {:>7} usec\n", concurrency,
+                   uint64_t(rates.iops), uint64_t(rates.bytes_per_sec / (1024 * 1024)), rates.latencies.quantile(0.5),
+                   rates.latencies.quantile(0.99));
+        curve.add(sweep_point {concurrency, std::move(rates)});
+    }
+    auto &knee = curve.knee_point();
+    fmt::print("  knee at {} in flight: {} IOPS, p99 {} usec\n", knee.concurrency, uint64_t(knee.rates.iops),
+               knee.rates.latencies.quantile(0.99));
+    return curve;
+}
+
+struct request_cost {
+    uint64_t request_size;
+    uint64_t read_iops;
+    uint64_t read_latency_us;
+    uint64_t write_iops;
+    uint64_t write_latency_us;
+};
+
+struct read_under_write_point {
+    uint64_t write_bw;
+    uint64_t read_iops;
+    uint64_t read_latency_us;
+};
+
 struct disk_descriptor {
     std::string mountpoint;
     uint64_t read_iops;
     uint64_t read_bw;
     uint64_t write_iops;
     uint64_t write_bw;
+
+    // Measured by --sweep only, taken at the knee of each saturation curve.
+    std::optional<uint64_t> latency_goal_us;
+    std::optional<unsigned> saturation_concurrency;
+    std::vector<request_cost> request_costs;
+    std::optional<float> mixed_cost_factor;
+
+    // Measured by --read-under-write only.
+    std::vector<read_under_write_point> read_under_write;
+    std::optional<float> read_under_write_cost_factor;
 };
 
 void string_to_file(sstring conf_file, sstring buf) {
@@ -547,19 +932,59 @@ void write_configuration_file(sstring conf_file, std::string format, sstring pro
     string_to_file(conf_file, buf);
 }
 
+void emit_disk_descriptor(YAML::Emitter &out, const disk_descriptor &desc) {
+    out << YAML::BeginMap;
+    out << YAML::Key << "mountpoint" << YAML::Value << desc.mountpoint;
+    out << YAML::Key << "read_iops" << YAML::Value << desc.read_iops;
+    out << YAML::Key << "read_bandwidth" << YAML::Value << desc.read_bw;
+    out << YAML::Key << "write_iops" << YAML::Value << desc.write_iops;
+    out << YAML::Key << "write_bandwidth" << YAML::Value << desc.write_bw;
+    if (desc.latency_goal_us) {
+        out << YAML::Key << "latency_goal_us" << YAML::Value << *desc.latency_goal_us;
+    }
+    if (desc.saturation_concurrency) {
+        out << YAML::Key << "saturation_concurrency" << YAML::Value << *desc.saturation_concurrency;
+    }
+    if (!desc.request_costs.empty()) {
+        out << YAML::Key << "request_costs" << YAML::Value << YAML::BeginSeq;
+        for (auto &cost : desc.request_costs) {
+            out << YAML::BeginMap;
+            out << YAML::Key << "request_size" << YAML::Value << cost.request_size;
+            out << YAML::Key << "read_iops" << YAML::Value << cost.read_iops;
+            out << YAML::Key << "read_latency_us" << YAML::Value << cost.read_latency_us;
+            out << YAML::Key << "write_iops" << YAML::Value << cost.write_iops;
+            out << YAML::Key << "write_latency_us" << YAML::Value << cost.write_latency_us;
+            out << YAML::EndMap;
+        }
+        out << YAML::EndSeq;
+    }
+    if (desc.mixed_cost_factor) {
+        out << YAML::Key << "mixed_cost_factor" << YAML::Value << *desc.mixed_cost_factor;
+    }
+    if (!desc.read_under_write.empty()) {
+        out << YAML::Key << "read_under_write" << YAML::Value << YAML::BeginSeq;
+        for (auto &point : desc.read_under_write) {
+            out << YAML::BeginMap;
+            out << YAML::Key << "write_bandwidth" << YAML::Value << point.write_bw;
+            out << YAML::Key << "read_iops" << YAML::Value << point.read_iops;
+            out << YAML::Key << "read_latency_us" << YAML::Value << point.read_latency_us;
+            out << YAML::EndMap;
+        }
+        out << YAML::EndSeq;
+    }
+    if (desc.read_under_write_cost_factor) {
+        out << YAML::Key << "read_under_write_cost_factor" << YAML::Value << *desc.read_under_write_cost_factor;
+    }
+    out << YAML::EndMap;
+}
+
 void write_property_file(sstring conf_file, std::vector<disk_descriptor> disk_descriptors) {
     YAML::Emitter out;
     out << YAML::BeginMap;
     out << YAML::Key << "disks";
     out << YAML::BeginSeq;
     for (auto &desc : disk_descriptors) {
-        out << YAML::BeginMap;
-        out << YAML::Key << "mountpoint" << YAML::Value << desc.mountpoint;
-        out << YAML::Key << "read_iops" << YAML::Value << desc.read_iops;
-        out << YAML::Key << "read_bandwidth" << YAML::Value << desc.read_bw;
-        out << YAML::Key << "write_iops" << YAML::Value << desc.write_iops;
-        out << YAML::Key << "write_bandwidth" << YAML::Value << desc.write_bw;
-        out << YAML::EndMap;
+        emit_disk_descriptor(out, desc);
     }
     out << YAML::EndSeq;
     out << YAML::EndMap;
@@ -568,6 +993,116 @@ void write_property_file(sstring conf_file, std::vector<disk_descriptor> disk_de
     string_to_file(conf_file, sstring(out.c_str(), out.size()));
 }
 
+namespace YAML {
+    template<>
+    struct convert<request_cost> {
+        static bool decode(const Node &node, request_cost &cost) {
+            cost.request_size = node["request_size"].as<uint64_t>();
+            cost.read_iops = node["read_iops"].as<uint64_t>();
+            cost.read_latency_us = node["read_latency_us"].as<uint64_t>();
+            cost.write_iops = node["write_iops"].as<uint64_t>();
+            cost.write_latency_us = node["write_latency_us"].as<uint64_t>();
+            return true;
+        }
+    };
+
+    template<>
+    struct convert<read_under_write_point> {
+        static bool decode(const Node &node, read_under_write_point &point) {
+            point.write_bw = node["write_bandwidth"].as<uint64_t>();
+            point.read_iops = node["read_iops"].as<uint64_t>();
+            point.read_latency_us = node["read_latency_us"].as<uint64_t>();
+            return true;
+        }
+    };
+
+    template<>
+    struct convert<disk_descriptor> {
+        static bool decode(const Node &node, disk_descriptor &desc) {
+            desc.mountpoint = node["mountpoint"].as<std::string>();
+            desc.read_iops = node["read_iops"].as<uint64_t>();
+            desc.read_bw = node["read_bandwidth"].as<uint64_t>();
+            desc.write_iops = node["write_iops"].as<uint64_t>();
+            desc.write_bw = node["write_bandwidth"].as<uint64_t>();
+            if (node["latency_goal_us"]) {
+                desc.latency_goal_us = node["latency_goal_us"].as<uint64_t>();
+            }
+            if (node["saturation_concurrency"]) {
+                desc.saturation_concurrency = node["saturation_concurrency"].as<unsigned>();
+            }
+            if (node["request_costs"]) {
+                desc.request_costs = node["request_costs"].as<std::vector<request_cost>>();
+            }
+            if (node["mixed_cost_factor"]) {
+                desc.mixed_cost_factor = node["mixed_cost_factor"].as<float>();
+            }
+            if (node["read_under_write"]) {
+                desc.read_under_write = node["read_under_write"].as<std::vector<read_under_write_point>>();
+            }
+            if (node["read_under_write_cost_factor"]) {
+                desc.read_under_write_cost_factor = node["read_under_write_cost_factor"].as<float>();
+            }
+            return true;
+        }
+    };
+}    // namespace YAML
+
+// Results of earlier evaluations keyed by evaluation_directory::device_id() and the options that
+// change the results, so that tuning a machine with the same disks as one already tuned, the same
+// way, takes no time.
+class results_cache {
+    sstring _file;
+    std::map<std::string, disk_descriptor> _entries;
+
+public:
+    explicit results_cache(sstring file) : _file(file) {
+        if (!boost::filesystem::exists(_file.c_str())) {
+            return;
+        }
+        // A cache that can't be read is a miss; it is rewritten when results are stored.
+        try {
+            auto root = YAML::LoadFile(_file);
+            for (auto entry : root["devices"]) {
+                _entries[entry["id"].as<std::string>()] = entry["properties"].as<disk_descriptor>();
+            }
+        } catch (...) {
+            iotune_logger.warn("Ignoring unreadable cache file {}: {}", _file, std::current_exception());
+            _entries.clear();
+        }
+    }
+
+    static std::string key(const std::string &device_id, const std::string &parameters) {
+        return device_id + " " + parameters;
+    }
+
+    std::optional<disk_descriptor> find(const std::string &key) const {
+        auto it = _entries.find(key);
+        if (it == _entries.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    void store(const std::string &key, const disk_descriptor &desc) {
+        _entries[key] = desc;
+        YAML::Emitter out;
+        out << YAML::BeginMap;
+        out << YAML::Key << "devices" << YAML::Value << YAML::BeginSeq;
+        for (auto &entry : _entries) {
+            out << YAML::BeginMap;
+            out << YAML::Key << "id" << YAML::Value << entry.first;
+            out << YAML::Key << "properties" << YAML::Value;
+            emit_disk_descriptor(out, entry.second);
+            out << YAML::EndMap;
+        }
+        out << YAML::EndSeq;
+        out << YAML::EndMap;
+        out << YAML::Newline;
+
+        string_to_file(_file, sstring(out.c_str(), out.size()));
+    }
+};
+
 // Returns the mountpoint of a path. It works by walking backwards from the canonical path
 // (absolute, with symlinks resolved), until we find a point that crosses a device ID.
 boost::filesystem::path mountpoint_of(sstring filename) {
@@ -588,9 +1123,87 @@ boost::filesystem::path mountpoint_of(sstring filename) {
     return mnt_candidate;
 }
 
+// Ramps concurrency for random reads and writes of several request sizes, and fills the
+// sweep-only fields of the descriptor from the knees of the curves. Must run in a thread.
+void sweep_disk(iotune_multi_shard_context &iotune_tests, const ::evaluation_directory &test_directory,
+                std::chrono::duration<double> step, disk_descriptor &desc) {
+    auto max_concurrency = std::min(test_directory.max_iodepth(), 128 * smp::count);
+    std::vector<size_t> sizes;
+    for (size_t size : {4u << 10, 16u << 10, 64u << 10, 128u << 10}) {
+        size = std::max<size_t>(size, test_directory.minimum_io_size());
+        if (sizes.empty() || sizes.back() != size) {
+            sizes.push_back(size);
+        }
+    }
+
+    std::optional<sweep_point> small_reads, small_writes;
+    for (auto size : sizes) {
+        auto reads = sweep("random read", size, max_concurrency, [&](unsigned concurrency) {
+            return iotune_tests.read_random_data(size, step, concurrency);
+        });
+        auto writes = sweep("random write", size, max_concurrency, [&](unsigned concurrency) {
+            return iotune_tests.write_random_data(size, step, concurrency);
+        });
+        auto &rk = reads.knee_point();
+        auto &wk = writes.knee_point();
+        desc.request_costs.push_back(request_cost {size, uint64_t(rk.rates.iops), rk.rates.latencies.quantile(0.99),
+                                                   uint64_t(wk.rates.iops), wk.rates.latencies.quantile(0.99)});
+        if (!small_reads) {
+            small_reads = rk;
+            small_writes = wk;
+        }
+    }
+    desc.latency_goal_us = small_reads->rates.latencies.quantile(0.99);
+    desc.saturation_concurrency = small_reads->concurrency;
+
+    // If reads and writes only competed for the same device time, a 50/50 mix would run at the
+    // harmonic mean of the two rates; the factor is how much more expensive mixing is than that.
+    fmt::print("Measuring mixed random read/write IOPS: ");
+    std::cout.flush();
+    auto mixed = iotune_tests.mixed_random_data(sizes.front(), 0.5, step, small_reads->concurrency).get0();
+    auto expected = 1 / (0.5 / small_reads->rates.iops + 0.5 / small_writes->rates.iops);
+    desc.mixed_cost_factor = mixed.iops ? expected / mixed.iops : 1;
+    fmt::print("{} IOPS, cost factor {:.2f}\n", uint64_t(mixed.iops), *desc.mixed_cost_factor);
+}
+
+// Runs random reads against sequential writes at a few fractions of the write bandwidth measured alone.
+// If writes only took their share of device time, reads would keep read_iops * (1 - w / write_bw);
+// the cost factor k fits read_iops * (1 - k * w / write_bw) to what was measured instead, so k = 1
+// means no interference beyond sharing the device and larger values mean writes hurt reads more.
+// Must run in a thread.
+void measure_read_under_write(iotune_multi_shard_context &iotune_tests, const ::evaluation_directory &test_directory,
+                              size_t write_size, std::chrono::duration<double> duration, disk_descriptor &desc) {
+    const std::vector<double> fractions = {0.25, 0.5, 0.75};
+    double num = 0, den = 0;
+    for (auto fraction : fractions) {
+        auto write_bw = desc.write_bw * fraction;
+        fmt::print("Measuring random read IOPS under {} MB/s of writes: ", uint64_t(write_bw / (1024 * 1024)));
+        std::cout.flush();
+        auto rates = iotune_tests
+                         .read_under_write(test_directory.minimum_io_size(), write_size, write_bw,
+                                           duration / fractions.size())
+                         .get0();
+        fmt::print("{} IOPS, p99 {} usec ({} MB/s written)\n", uint64_t(rates.reads.iops),
+                   rates.reads.latencies.quantile(0.99), uint64_t(rates.writes.bytes_per_sec / (1024 * 1024)));
+        desc.read_under_write.push_back(read_under_write_point {uint64_t(rates.writes.bytes_per_sec),
+                                                                uint64_t(rates.reads.iops),
+                                                                rates.reads.latencies.quantile(0.99)});
+        // least squares fit of the read loss against the share of write bandwidth actually used
+        auto share = rates.writes.bytes_per_sec / desc.write_bw;
+        auto loss = 1 - rates.reads.iops / desc.read_iops;
+        num += loss * share;
+        den += share * share;
+    }
+    desc.read_under_write_cost_factor = den ? std::max(num / den, 0.0) : 1;
+    fmt::print("Read under write cost factor: {:.2f}\n", *desc.read_under_write_cost_factor);
+}
+
 int main(int ac, char **av) {
     namespace bpo = boost::program_options;
     bool fs_check = false;
+    bool sweep_mode = false;
+    bool read_under_write = false;
+    bool adaptive = false;
 
     app_template::config app_cfg;
     app_cfg.name = "IOTune";
@@ -611,7 +1224,19 @@ int main(int ac, char **av) {
                                                                                       bpo::bool_switch(&fs_check),
                                                                                       "perform "
                                                                                       "FS check "
-                                                                                      "only");
+                                                                                      "only")(
+        "sweep", bpo::bool_switch(&sweep_mode),
+        "also ramp concurrency per request size to find where latency takes off, and write the extended "
+        "properties")("sweep-step-duration", bpo::value<double>()->default_value(1.0),
+                      "time, in seconds, for which to run every step of the sweep")(
+        "read-under-write", bpo::bool_switch(&read_under_write),
+        "also measure random reads running concurrently with sequential writes at several write bandwidths")(
+        "adaptive", bpo::bool_switch(&adaptive),
+        "stop every measurement as soon as its throughput converges; --duration becomes an upper bound")(
+        "convergence-tolerance", bpo::value<double>()->default_value(0.02),
+        "with --adaptive, relative half-width of the 95% confidence interval at which a measurement stops")(
+        "cache-file", bpo::value<sstring>(),
+        "reuse results of disks with the same identity found in this file, and store new ones there");
 
     return app.run(ac, av, [&] {
         return nil::actor::async([&] {
@@ -619,6 +1244,23 @@ int main(int ac, char **av) {
             auto eval_dirs = configuration["evaluation-directory"].as<std::vector<sstring>>();
             auto format = configuration["format"].as<sstring>();
             auto duration = std::chrono::duration<double>(configuration["duration"].as<unsigned>() * 1s);
+            std::optional<double> tolerance;
+            if (adaptive) {
+                tolerance = configuration["convergence-tolerance"].as<double>();
+            }
+            std::optional<::results_cache> results_cache;
+            if (configuration.count("cache-file")) {
+                results_cache.emplace(configuration["cache-file"].as<sstring>());
+            }
+            // Everything besides the disks that changes the results; a run with other options
+            // measures anew.
+            auto cache_parameters = fmt::format(
+                "shards={} duration={} adaptive={} sweep={} read-under-write={}", smp::count,
+                configuration["duration"].as<unsigned>(),
+                tolerance ? fmt::format("{}", *tolerance) : std::string("off"),
+                sweep_mode ? fmt::format("{}s-steps", configuration["sweep-step-duration"].as<double>())
+                           : std::string("off"),
+                read_under_write);
 
             std::vector<disk_descriptor> disk_descriptors;
             std::unordered_map<sstring, sstring> mountpoint_map;
@@ -669,7 +1311,18 @@ int main(int ac, char **av) {
                                    test_directory.max_iodepth(), test_directory.disks_per_array(),
                                    test_directory.minimum_io_size());
 
-                ::iotune_multi_shard_context iotune_tests(test_directory);
+                auto device_id = test_directory.device_id();
+                auto cache_key = ::results_cache::key(device_id, cache_parameters);
+                if (results_cache && !device_id.empty()) {
+                    if (auto cached = results_cache->find(cache_key)) {
+                        fmt::print("Using cached results for {} ({})\n", mountpoint, device_id);
+                        cached->mountpoint = mountpoint;
+                        disk_descriptors.push_back(std::move(*cached));
+                        continue;
+                    }
+                }
+
+                ::iotune_multi_shard_context iotune_tests(test_directory, tolerance);
                 iotune_tests.start().get();
                 auto stop = defer([&iotune_tests] {
                     try {
@@ -717,6 +1370,21 @@ int main(int ac, char **av) {
                 desc.read_bw = read_bw.bytes_per_sec;
                 desc.write_iops = write_iops.iops;
                 desc.write_bw = write_bw.bytes_per_sec;
+                if (read_under_write) {
+                    measure_read_under_write(iotune_tests, test_directory, sequential_buffer_size, duration * 0.1,
+                                             desc);
+                }
+                if (sweep_mode) {
+                    auto step = std::chrono::duration<double>(configuration["sweep-step-duration"].as<double>());
+                    sweep_disk(iotune_tests, test_directory, step, desc);
+                }
+                if (results_cache && !device_id.empty()) {
+                    try {
+                        results_cache->store(cache_key, desc);
+                    } catch (...) {
+                        iotune_logger.warn("Can't update the cache file: {}", std::current_exception());
+                    }
+                }
                 disk_descriptors.push_back(std::move(desc));
             }
 
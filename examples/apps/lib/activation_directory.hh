@@ -0,0 +1,261 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+
+#pragma once
+
+#include <nil/actor/core/future.hh>
+#include <nil/actor/core/lowres_clock.hh>
+#include <nil/actor/core/timer-set.hh>
+#include <nil/actor/core/timer.hh>
+
+#include <boost/intrusive/list.hpp>
+
+#include <chrono>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+/// Actor apps lib namespace
+
+namespace actor_apps_lib {
+
+    namespace detail {
+        template<typename Actor, typename State, typename = void>
+        struct has_on_deactivate : std::false_type { };
+
+        template<typename Actor, typename State>
+        struct has_on_deactivate<Actor, State,
+                                 std::void_t<decltype(Actor::on_deactivate(
+                                     std::declval<const typename Actor::KeyType &>(), std::declval<State &>()))>>
+            : std::true_type { };
+    }    // namespace detail
+
+    /// \brief Shard-local directory of virtual actor state with idle deactivation
+    ///
+    /// Virtual actors are materialized on first use and never go away, so state kept in the actor
+    /// itself grows with the number of keys ever used. Keeping it in an activation directory
+    /// instead bounds it by the number of keys used recently: the state of a key is created on
+    /// first access and dropped once it hasn't been accessed for the actor's idle timeout.
+    ///
+    /// The timeout is declared by the actor type next to ACTOR_DEFINE_ACTOR, as a static
+    /// idle_timeout duration. If the actor also declares a static on_deactivate(key, state), it is
+    /// called with the state right before it is dropped, for instance to persist it.
+    ///
+    /// Expiry is lazy and uses a timer_set, the bucketed timer wheel the memcached app expires
+    /// items with: an access only stamps the activation, and when its timer fires an activation
+    /// that was used in the meantime is put back for the rest of its timeout. Activations used by
+    /// a pending with_activation() are never deactivated.
+    ///
+    /// The directory is not thread-safe; keep one per shard, and stop() it on that shard before
+    /// the reactor exits.
+    ///
+    /// Example:
+    /// \code
+    /// #include "../lib/activation_directory.hh"
+    /// ...
+    /// class fibonacci_actor : public nil::actor::actor<fibonacci_actor> {
+    /// public:
+    ///     static constexpr auto idle_timeout = std::chrono::minutes(10);
+    ///     static void on_deactivate(const KeyType &key, int &result);
+    ///     ACTOR_DEFINE_ACTOR(fibonacci_actor, (fib));
+    ///     ...
+    /// };
+    ///
+    /// static thread_local actor_apps_lib::activation_directory<fibonacci_actor, int> results;
+    /// ...
+    /// return results.with_activation(key, [](int &result) { ... });
+    /// \endcode
+    template<typename Actor, typename State>
+    class activation_directory {
+    public:
+        using key_type = typename Actor::KeyType;
+        using clock_type = nil::actor::lowres_clock;
+
+    private:
+        struct activation {
+            const key_type *key = nullptr;
+            State state {};
+            clock_type::time_point last_used;
+            clock_type::time_point timeout;
+            unsigned users = 0;
+            boost::intrusive::list_member_hook<> _timer_link;
+
+            // needed by timer_set
+            clock_type::time_point get_timeout() const {
+                return timeout;
+            }
+
+            bool cancel() {
+                return false;
+            }
+        };
+
+        clock_type::duration _idle_timeout;
+        std::unordered_map<key_type, activation> _activations;
+        nil::actor::timer_set<activation, &activation::_timer_link> _alive;
+        nil::actor::timer<clock_type> _timer;
+        uint64_t _activated = 0;
+        uint64_t _deactivated = 0;
+
+        void schedule(activation &a, clock_type::time_point timeout) {
+            a.timeout = timeout;
+            if (_alive.insert(a)) {
+                _timer.rearm(a.get_timeout());
+            }
+        }
+
+        activation &touch(const key_type &key) {
+            auto now = clock_type::now();
+            auto [it, inserted] = _activations.try_emplace(key);
+            auto &a = it->second;
+            a.last_used = now;
+            if (inserted) {
+                a.key = &it->first;
+                _activated++;
+                schedule(a, now + _idle_timeout);
+            }
+            return a;
+        }
+
+        void drop(typename std::unordered_map<key_type, activation>::iterator it) {
+            if constexpr (detail::has_on_deactivate<Actor, State>::value) {
+                Actor::on_deactivate(it->first, it->second.state);
+            }
+            _activations.erase(it);
+            _deactivated++;
+        }
+
+        void expire() {
+            auto now = clock_type::now();
+            auto expired = _alive.expire(now);
+            while (!expired.empty()) {
+                auto &a = *expired.begin();
+                expired.pop_front();
+                auto idle_until = a.last_used + _idle_timeout;
+                if (a.users || idle_until > now) {
+                    // used since it was scheduled; check again once it may have become idle
+                    a.timeout = a.users ? now + _idle_timeout : idle_until;
+                    _alive.insert(a);
+                    continue;
+                }
+                drop(_activations.find(*a.key));
+            }
+            _timer.arm(_alive.get_next_timeout());
+        }
+
+    public:
+        explicit activation_directory(clock_type::duration idle_timeout =
+                                          std::chrono::duration_cast<clock_type::duration>(Actor::idle_timeout)) :
+            _idle_timeout(idle_timeout) {
+            _timer.set_callback([this] { expire(); });
+        }
+
+        activation_directory(const activation_directory &) = delete;
+
+        ~activation_directory() {
+            _timer.cancel();
+        }
+
+        /// Returns the state of the key, activating it if needed. The reference is valid until the
+        /// key is deactivated, which can happen as soon as the caller yields.
+        State &get(const key_type &key) {
+            return touch(key).state;
+        }
+
+        /// Calls func with the state of the key, activating it if needed. The key stays active
+        /// at least until the future returned by func resolves.
+        template<typename Func>
+        auto with_activation(const key_type &key, Func func) {
+            auto &a = touch(key);
+            a.users++;
+            return nil::actor::futurize_invoke(func, a.state).finally([this, &a] {
+                a.users--;
+                a.last_used = clock_type::now();
+            });
+        }
+
+        /// Deactivates the key right away, unless it is in use. Returns whether it was.
+        bool deactivate(const key_type &key) {
+            auto it = _activations.find(key);
+            if (it == _activations.end() || it->second.users) {
+                return false;
+            }
+            _alive.remove(it->second);
+            drop(it);
+            return true;
+        }
+
+        /// Removes the state of the key without deactivating it, to move it to another shard;
+        /// install() it there. Returns nothing if the key isn't active. The key must not be in use.
+        std::optional<State> extract(const key_type &key) {
+            auto it = _activations.find(key);
+            if (it == _activations.end()) {
+                return std::nullopt;
+            }
+            if (it->second.users) {
+                throw std::logic_error("extracting an activation in use");
+            }
+            _alive.remove(it->second);
+            auto state = std::move(it->second.state);
+            _activations.erase(it);
+            return state;
+        }
+
+        /// Activates the key with the given state, typically extracted on another shard.
+        void install(const key_type &key, State state) {
+            touch(key).state = std::move(state);
+        }
+
+        /// Deactivates every key not in use and stops expiring; call it before the reactor exits.
+        void stop() {
+            _timer.cancel();
+            for (auto it = _activations.begin(); it != _activations.end();) {
+                auto next = std::next(it);
+                if (!it->second.users) {
+                    _alive.remove(it->second);
+                    drop(it);
+                }
+                it = next;
+            }
+        }
+
+        /// Activations currently alive.
+        size_t live() const noexcept {
+            return _activations.size();
+        }
+
+        /// Activations created since the directory was.
+        uint64_t activated() const noexcept {
+            return _activated;
+        }
+
+        /// Activations dropped since the directory was created, by idle timeout or deactivate().
+        uint64_t deactivated() const noexcept {
+            return _deactivated;
+        }
+    };
+}    // namespace actor_apps_lib
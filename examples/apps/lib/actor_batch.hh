@@ -0,0 +1,85 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+
+#pragma once
+
+#include <nil/actor/core/future-util.hh>
+#include <nil/actor/core/loop.hh>
+#include <nil/actor/core/smp.hh>
+
+#include <nil/actor/actor_ref.hpp>
+
+#include <boost/range/irange.hpp>
+
+#include <vector>
+
+#include "actor_placement.hh"
+
+/// Actor apps lib namespace
+
+namespace actor_apps_lib {
+
+    /// \brief Sends a message to many actors with one cross-shard submission per shard
+    ///
+    /// Sending a message through actor_ref::operator-> to an actor on another shard is a
+    /// cross-shard task of its own, so fanning out to N actors costs N submissions. tell_all()
+    /// groups the keys by the shard placement puts them on, moves every group to its shard with a
+    /// single submit_to(), and there calls func with the reference of each actor of the group.
+    /// The actors being local to the shard, the messages func sends are plain local calls.
+    ///
+    /// placement is one of the strategies of actor_placement.hh and has to agree with the actor
+    /// type's own placement, or messages are forwarded to the right shard one by one, which is
+    /// correct but defeats the purpose. func is copied to every shard involved and must return a
+    /// future. The returned future fails if any message failed; all messages are sent regardless.
+    ///
+    /// Example:
+    /// \code
+    /// #include "../lib/actor_batch.hh"
+    /// ...
+    /// return actor_apps_lib::tell_all<worker>(std::move(keys), [](auto ref) { return ref->process(); });
+    /// \endcode
+    template<typename Actor, typename Func, typename Placement = hash_placement<Actor>>
+    nil::actor::future<> tell_all(std::vector<typename Actor::KeyType> keys, Func func,
+                                  Placement placement = Placement()) {
+        std::vector<std::vector<typename Actor::KeyType>> groups(nil::actor::smp::count);
+        for (auto &key : keys) {
+            groups[placement(key)].push_back(std::move(key));
+        }
+        return nil::actor::do_with(std::move(groups), [func = std::move(func)](auto &groups) {
+            return nil::actor::parallel_for_each(
+                boost::irange(0u, nil::actor::smp::count), [&groups, &func](unsigned shard) {
+                    if (groups[shard].empty()) {
+                        return nil::actor::make_ready_future<>();
+                    }
+                    return nil::actor::smp::submit_to(shard, [group = std::move(groups[shard]), func]() mutable {
+                        return nil::actor::do_with(std::move(group), std::move(func), [](auto &group, auto &func) {
+                            return nil::actor::parallel_for_each(
+                                group, [&func](auto &key) { return func(nil::actor::get<Actor>(key)); });
+                        });
+                    });
+                });
+        });
+    }
+}    // namespace actor_apps_lib
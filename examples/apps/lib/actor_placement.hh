@@ -0,0 +1,596 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+
+#pragma once
+
+#include <nil/actor/core/future.hh>
+#include <nil/actor/core/gate.hh>
+#include <nil/actor/core/loop.hh>
+#include <nil/actor/core/metrics.hh>
+#include <nil/actor/core/reactor.hh>
+#include <nil/actor/core/shared_future.hh>
+#include <nil/actor/core/sharded.hh>
+#include <nil/actor/core/smp.hh>
+#include <nil/actor/core/timer.hh>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/// Actor apps lib namespace
+
+namespace actor_apps_lib {
+
+    /// Places every key on the shard its hash maps to, the way virtual actors are placed by default.
+    template<typename Actor>
+    struct hash_placement {
+        unsigned operator()(const typename Actor::KeyType &key,
+                            unsigned caller = nil::actor::this_shard_id()) const {
+            return std::hash<typename Actor::KeyType> {}(key) % nil::actor::smp::count;
+        }
+    };
+
+    /// Places every key on a random shard, spreading popular keys that hash to the same shard.
+    template<typename Actor>
+    struct random_placement {
+        unsigned operator()(const typename Actor::KeyType &key,
+                            unsigned caller = nil::actor::this_shard_id()) const {
+            static thread_local std::minstd_rand rng(std::random_device {}());
+            return std::uniform_int_distribution<unsigned>(0, nil::actor::smp::count - 1)(rng);
+        }
+    };
+
+    /// Places every key on the shard of its first caller, so that keys mostly used from one
+    /// shard are never reached across shards.
+    template<typename Actor>
+    struct local_placement {
+        unsigned operator()(const typename Actor::KeyType &key,
+                            unsigned caller = nil::actor::this_shard_id()) const {
+            return caller;
+        }
+    };
+
+    /// \brief Per-shard view of the utilization of all shards
+    ///
+    /// Every period each shard measures the fraction of time its reactor was busy and sends it to
+    /// all shards, so every shard can tell the least loaded one without a round trip. Start it
+    /// with sharded::start() and then start_sampling() on every shard.
+    class shard_load_monitor : public nil::actor::peering_sharded_service<shard_load_monitor> {
+        std::chrono::milliseconds _period;
+        std::vector<double> _loads = std::vector<double>(nil::actor::smp::count);
+        // placements made on this shard since the last update, per target shard, so a burst of
+        // placements doesn't pile onto the shard that was least loaded at the last update
+        std::vector<unsigned> _placed = std::vector<unsigned>(nil::actor::smp::count);
+        std::chrono::steady_clock::time_point _last_sample;
+        std::chrono::nanoseconds _last_busy {0};
+        nil::actor::timer<> _timer;
+        nil::actor::gate _updates;
+
+        void sample() {
+            auto now = std::chrono::steady_clock::now();
+            auto busy = nil::actor::engine().total_busy_time();
+            auto elapsed = std::chrono::duration<double>(now - _last_sample).count();
+            auto load = elapsed > 0 ? std::chrono::duration<double>(busy - _last_busy).count() / elapsed : 0.0;
+            _last_sample = now;
+            _last_busy = busy;
+            auto shard = nil::actor::this_shard_id();
+            (void)nil::actor::with_gate(_updates, [this, shard, load = std::min(load, 1.0)] {
+                return container().invoke_on_all([shard, load](shard_load_monitor &m) {
+                    m._loads[shard] = load;
+                    m._placed[shard] = 0;
+                });
+            });
+        }
+
+    public:
+        /// Load added to a shard per placement made since its last update.
+        static constexpr double placement_weight = 0.01;
+
+        explicit shard_load_monitor(std::chrono::milliseconds period = std::chrono::milliseconds(100)) :
+            _period(period), _timer([this] { sample(); }) {
+        }
+
+        void start_sampling() {
+            _last_sample = std::chrono::steady_clock::now();
+            _last_busy = nil::actor::engine().total_busy_time();
+            _timer.arm_periodic(_period);
+        }
+
+        nil::actor::future<> stop() {
+            _timer.cancel();
+            return _updates.close();
+        }
+
+        /// Utilization of the shard, between 0 and 1, as of its last update.
+        double load(unsigned shard) const {
+            return _loads[shard];
+        }
+
+        /// Picks the least loaded shard, preferring the given one on ties, and accounts for the
+        /// placement until that shard's next update.
+        unsigned place(unsigned preferred) {
+            auto estimate = [this](unsigned s) { return _loads[s] + _placed[s] * placement_weight; };
+            auto best = preferred;
+            for (unsigned s = 0; s < nil::actor::smp::count; ++s) {
+                if (estimate(s) < estimate(best)) {
+                    best = s;
+                }
+            }
+            _placed[best]++;
+            return best;
+        }
+    };
+
+    /// Places every key on the shard with the lowest reactor utilization when it is placed.
+    template<typename Actor>
+    class least_loaded_placement {
+        nil::actor::sharded<shard_load_monitor> *_monitor;
+
+    public:
+        explicit least_loaded_placement(nil::actor::sharded<shard_load_monitor> &monitor) : _monitor(&monitor) {
+        }
+
+        unsigned operator()(const typename Actor::KeyType &key, unsigned caller = nil::actor::this_shard_id()) const {
+            return _monitor->local().place(caller);
+        }
+    };
+
+    /// \brief Directory of the shards keys were placed on by a placement strategy
+    ///
+    /// The hash placement needs no bookkeeping, since the shard of a key can be computed anywhere:
+    /// calls go straight to the key's home shard, the one its hash maps to, and only keys migrated
+    /// away from it are recorded there. Other strategies decide once, when a key is first used, so
+    /// the decision is recorded on the key's home shard, where every shard asks for it. Callers
+    /// cache the answers, so a key is looked up across shards once per calling shard. A key stays
+    /// on its shard until it is migrated or forgotten, so work routed through the directory always
+    /// finds the state it left on that shard, for example in an activation_directory.
+    ///
+    /// migrate() moves a key to another shard while it is in use: calls arriving for the key wait
+    /// until the calls running on it are done and the migration hook has moved its state, and
+    /// are then forwarded to the new shard, as are calls still sent to the old shard through a
+    /// stale cache. The old shard stops forwarding once every shard has dropped its cached
+    /// placement and the calls they sent before are in. A shard only keeps entries for the keys it
+    /// is running calls for or migrating, and the call counts of its keys until the next
+    /// reset_heat().
+    ///
+    /// Run it as a sharded service with the same strategy on every shard. The statistics are
+    /// registered as metrics of the "placement" group, labelled with the name of the directory,
+    /// so directories running on the same shards need different names.
+    ///
+    /// Example:
+    /// \code
+    /// #include "../lib/actor_placement.hh"
+    /// ...
+    /// using directory = actor_apps_lib::placement_directory<session, actor_apps_lib::local_placement<session>>;
+    /// nil::actor::sharded<directory> sessions;
+    /// sessions.start(actor_apps_lib::local_placement<session>(), "sessions").get();
+    /// ...
+    /// return sessions.local().invoke_on_placed(key, [](const session::KeyType &key) { ... });
+    /// \endcode
+    template<typename Actor, typename Strategy>
+    class placement_directory : public nil::actor::peering_sharded_service<placement_directory<Actor, Strategy>> {
+    public:
+        using key_type = typename Actor::KeyType;
+        /// Moves the state of the key from the current shard to the given one.
+        using migration_hook = std::function<nil::actor::future<>(const key_type &key, unsigned to)>;
+
+        struct stats {
+            uint64_t migrations_out = 0;
+            uint64_t migrations_in = 0;
+            // calls that arrived on a shard the key had left, and were sent on
+            uint64_t forwarded = 0;
+            // calls that waited for a migration of their key to finish
+            uint64_t delayed = 0;
+        };
+
+    private:
+        // a key placed on this shard that is in use or migrating; idle keys have no entry
+        struct hosted {
+            // calls running on this shard
+            unsigned active = 0;
+            std::optional<nil::actor::shared_promise<>> migrating;
+            std::optional<nil::actor::promise<>> drained;
+        };
+
+        Strategy _strategy;
+        migration_hook _migration_hook;
+        // decisions for the keys this shard is the home of
+        std::unordered_map<key_type, unsigned> _placed;
+        // decisions this shard has asked for
+        std::unordered_map<key_type, unsigned> _cache;
+        std::unordered_map<key_type, hosted> _hosted;
+        // calls per key since the last reset_heat()
+        std::unordered_map<key_type, uint64_t> _heat;
+        struct forwarding {
+            unsigned to;
+            // tells a later migration of the key from this shard apart
+            uint64_t migration;
+        };
+
+        static constexpr bool hashed = std::is_same_v<Strategy, hash_placement<Actor>>;
+
+        // keys migrated away from this shard, and where to
+        std::unordered_map<key_type, forwarding> _forward;
+        uint64_t _migrations = 0;
+        stats _stats;
+        nil::actor::gate _unforwards;
+        nil::actor::metrics::metric_groups _metrics;
+
+        static unsigned home(const key_type &key) {
+            return hash_placement<Actor>()(key);
+        }
+
+        unsigned place(const key_type &key, unsigned caller) {
+            auto it = _placed.find(key);
+            if (it != _placed.end()) {
+                return it->second;
+            }
+            // unless migrated, a hashed key lives on its home shard, which is this one
+            return hashed ? nil::actor::this_shard_id() : _placed.emplace(key, _strategy(key, caller)).first->second;
+        }
+
+        // Records where a migrated key went on its home shard.
+        void placed_on(const key_type &key, unsigned to) {
+            if (!hashed) {
+                _placed[key] = to;
+                return;
+            }
+            // calls for hashed keys come here without a lookup, and are forwarded to the key
+            if (to == nil::actor::this_shard_id()) {
+                _placed.erase(key);
+            } else {
+                _placed[key] = to;
+                _forward[key] = forwarding {to, 0};
+            }
+        }
+
+        // Once no shard has the key cached and the calls they sent here through stale caches have
+        // arrived, calls for the key no longer come here and the forwarding entry can go. The home
+        // shard of a hashed key keeps it: that is where every call for the key arrives.
+        void unforward_later(const key_type &key, uint64_t migration) {
+            if ((hashed && home(key) == nil::actor::this_shard_id()) || _unforwards.is_closed()) {
+                return;
+            }
+            auto self = nil::actor::this_shard_id();
+            (void)nil::actor::with_gate(_unforwards, [this, key, migration, self] {
+                return this->container()
+                    .invoke_on_all([self](placement_directory &d) {
+                        // queued behind whatever that shard has sent here before
+                        return d.container().invoke_on(self, [](placement_directory &) {});
+                    })
+                    .then([this, key, migration] {
+                        auto it = _forward.find(key);
+                        if (it != _forward.end() && it->second.migration == migration) {
+                            _forward.erase(it);
+                        }
+                    });
+            }).handle_exception([](std::exception_ptr) {});
+        }
+
+        void register_metrics(const nil::actor::sstring &name) {
+            namespace sm = nil::actor::metrics;
+            auto directory = sm::label("directory");
+            _metrics.add_group(
+                "placement",
+                {
+                    sm::make_derive("migrations_out", _stats.migrations_out,
+                                    sm::description("Keys migrated away from this shard"), {directory(name)}),
+                    sm::make_derive("migrations_in", _stats.migrations_in,
+                                    sm::description("Keys migrated to this shard"), {directory(name)}),
+                    sm::make_derive("forwarded", _stats.forwarded,
+                                    sm::description("Calls that arrived after their key left this shard and were "
+                                                    "forwarded to its new shard"),
+                                    {directory(name)}),
+                    sm::make_derive("delayed", _stats.delayed,
+                                    sm::description("Calls that waited for a migration of their key"),
+                                    {directory(name)}),
+                    sm::make_gauge(
+                        "placed_keys", [this] { return _placed.size(); },
+                        sm::description("Keys this shard is the home of and holds a placement for"),
+                        {directory(name)}),
+                    sm::make_gauge(
+                        "forwarding_keys", [this] { return _forward.size(); },
+                        sm::description("Keys migrated away from this shard that calls are still forwarded for"),
+                        {directory(name)}),
+                });
+        }
+
+        void done(const key_type &key) {
+            auto it = _hosted.find(key);
+            auto &h = it->second;
+            if (--h.active) {
+                return;
+            }
+            if (h.drained) {
+                h.drained->set_value();
+                h.drained.reset();
+            } else if (!h.migrating) {
+                _hosted.erase(it);
+            }
+        }
+
+        template<typename Func>
+        using result_type = nil::actor::futurize_t<std::invoke_result_t<Func &, const key_type &>>;
+
+        // Runs func on this shard, or wherever the key moved to.
+        template<typename Func>
+        result_type<Func> run_placed(const key_type &key, Func func) {
+            auto fwd = _forward.find(key);
+            if (fwd != _forward.end()) {
+                _stats.forwarded++;
+                return this->container().invoke_on(fwd->second.to,
+                                                   [key, func = std::move(func)](placement_directory &d) mutable {
+                                                       return d.run_placed(key, std::move(func));
+                                                   });
+            }
+            auto &h = _hosted[key];
+            if (h.migrating) {
+                _stats.delayed++;
+                return h.migrating->get_shared_future().then([this, key, func = std::move(func)]() mutable {
+                    return run_placed(key, std::move(func));
+                });
+            }
+            h.active++;
+            _heat[key]++;
+            return nil::actor::futurize_invoke(func, key).finally([this, key] { done(key); });
+        }
+
+        // Migrates a key known to be placed on this shard.
+        nil::actor::future<> migrate_hosted(const key_type &key, unsigned to) {
+            auto &h = _hosted[key];
+            if (h.migrating) {
+                return nil::actor::make_ready_future<>();
+            }
+            h.migrating.emplace();
+            auto drained = nil::actor::make_ready_future<>();
+            if (h.active) {
+                h.drained.emplace();
+                drained = h.drained->get_future();
+            }
+            return drained
+                .then([this, key, to] {
+                    return _migration_hook ? _migration_hook(key, to) : nil::actor::make_ready_future<>();
+                })
+                .then([this, key, to] {
+                    return this->container().invoke_on(to, [key](placement_directory &d) {
+                        d._forward.erase(key);
+                        d._stats.migrations_in++;
+                    });
+                })
+                .then([this, key, to] {
+                    return this->container().invoke_on(home(key),
+                                                       [key, to](placement_directory &d) { d.placed_on(key, to); });
+                })
+                .then_wrapped([this, key, to](nil::actor::future<> f) {
+                    auto it = _hosted.find(key);
+                    // waiting calls run once the current task is done, and find the key either still
+                    // hosted here or forwarded
+                    it->second.migrating->set_value();
+                    if (f.failed()) {
+                        it->second.migrating.reset();
+                        if (!it->second.active) {
+                            _hosted.erase(it);
+                        }
+                        return nil::actor::make_exception_future<>(f.get_exception());
+                    }
+                    _hosted.erase(it);
+                    _heat.erase(key);
+                    auto migration = ++_migrations;
+                    _forward[key] = forwarding {to, migration};
+                    _stats.migrations_out++;
+                    return this->container()
+                        .invoke_on_all([key](placement_directory &d) { d._cache.erase(key); })
+                        .then([this, key, migration] { unforward_later(key, migration); });
+                });
+        }
+
+    public:
+        explicit placement_directory(Strategy strategy = Strategy(), nil::actor::sstring name = "default") :
+            _strategy(std::move(strategy)) {
+            register_metrics(name);
+        }
+
+        nil::actor::future<> stop() {
+            return _unforwards.close();
+        }
+
+        /// Sets the hook migrate() moves state with; set it on every shard.
+        void set_migration_hook(migration_hook hook) {
+            _migration_hook = std::move(hook);
+        }
+
+        /// Resolves to the shard of the key, placing it if it has never been. With the hash
+        /// placement that is always the home shard, which forwards calls for migrated keys.
+        nil::actor::future<unsigned> locate(const key_type &key) {
+            if (hashed) {
+                return nil::actor::make_ready_future<unsigned>(home(key));
+            }
+            auto it = _cache.find(key);
+            if (it != _cache.end()) {
+                return nil::actor::make_ready_future<unsigned>(it->second);
+            }
+            auto caller = nil::actor::this_shard_id();
+            return this->container()
+                .invoke_on(home(key), [key, caller](placement_directory &d) { return d.place(key, caller); })
+                .then([this, key](unsigned shard) {
+                    _cache.emplace(key, shard);
+                    return shard;
+                });
+        }
+
+        /// Calls func(key) on the shard of the key.
+        template<typename Func>
+        auto invoke_on_placed(const key_type &key, Func func) {
+            return locate(key).then([this, key, func = std::move(func)](unsigned shard) mutable {
+                return this->container().invoke_on(shard,
+                                                   [key, func = std::move(func)](placement_directory &d) mutable {
+                                                       return d.run_placed(key, std::move(func));
+                                                   });
+            });
+        }
+
+        /// Moves a key placed on this shard to another one. Resolves once calls for the key run
+        /// on the new shard; if the migration hook fails the key stays here. Fails with
+        /// std::invalid_argument if the key isn't placed on this shard.
+        nil::actor::future<> migrate(const key_type &key, unsigned to) {
+            auto self = nil::actor::this_shard_id();
+            if (to == self) {
+                return nil::actor::make_ready_future<>();
+            }
+            return this->container()
+                .invoke_on(home(key),
+                           [key](placement_directory &d) {
+                               auto it = d._placed.find(key);
+                               if (it != d._placed.end()) {
+                                   return std::optional<unsigned>(it->second);
+                               }
+                               return hashed ? std::optional<unsigned>(home(key)) : std::nullopt;
+                           })
+                .then([this, key, to, self](std::optional<unsigned> shard) {
+                    if (shard != self || _forward.count(key)) {
+                        return nil::actor::make_exception_future<>(
+                            std::invalid_argument("migrating a key not placed on this shard"));
+                    }
+                    return migrate_hosted(key, to);
+                });
+        }
+
+        /// Drops the placement of the key everywhere, so its next use places it anew.
+        nil::actor::future<> forget(const key_type &key) {
+            return this->container().invoke_on_all([key](placement_directory &d) {
+                d._placed.erase(key);
+                d._cache.erase(key);
+                d._forward.erase(key);
+            });
+        }
+
+        /// Up to n keys placed on this shard with the most calls since the last reset_heat(),
+        /// hottest first.
+        std::vector<key_type> hottest(size_t n) const {
+            std::vector<std::pair<uint64_t, const key_type *>> heats;
+            for (auto &[key, heat] : _heat) {
+                auto h = _hosted.find(key);
+                if (h == _hosted.end() || !h->second.migrating) {
+                    heats.emplace_back(heat, &key);
+                }
+            }
+            n = std::min(n, heats.size());
+            std::partial_sort(heats.begin(), heats.begin() + n, heats.end(),
+                              [](auto &a, auto &b) { return a.first > b.first; });
+            std::vector<key_type> keys;
+            for (size_t i = 0; i < n; ++i) {
+                keys.push_back(*heats[i].second);
+            }
+            return keys;
+        }
+
+        /// Forgets the calls counted so far; the rebalancer does every period. Until it is called,
+        /// every key called on this shard is remembered with its count.
+        void reset_heat() {
+            _heat.clear();
+        }
+
+        /// Keys this shard is the home of.
+        size_t placed() const noexcept {
+            return _placed.size();
+        }
+
+        const stats &get_stats() const noexcept {
+            return _stats;
+        }
+    };
+
+    struct rebalancer_options {
+        std::chrono::milliseconds period = std::chrono::seconds(1);
+        /// How far above the mean utilization a shard has to be to move keys away.
+        double threshold = 0.2;
+        /// Keys moved away from a shard per period at most.
+        size_t max_migrations = 4;
+    };
+
+    /// \brief Moves the hottest keys off overloaded shards
+    ///
+    /// Every period, a shard whose utilization is more than threshold above the mean of all
+    /// shards migrates the keys that received the most calls during the period to the least
+    /// loaded shards, one at a time. Run it as a sharded service next to the directory and the
+    /// load monitor, passing both with std::ref().
+    template<typename Directory>
+    class rebalancer {
+        nil::actor::sharded<Directory> &_directory;
+        nil::actor::sharded<shard_load_monitor> &_monitor;
+        rebalancer_options _options;
+        nil::actor::timer<> _timer;
+        nil::actor::gate _migrations;
+        bool _busy = false;
+
+        void run() {
+            if (_busy) {
+                return;
+            }
+            auto &directory = _directory.local();
+            auto &monitor = _monitor.local();
+            auto self = nil::actor::this_shard_id();
+            double mean = 0;
+            for (unsigned s = 0; s < nil::actor::smp::count; ++s) {
+                mean += monitor.load(s) / nil::actor::smp::count;
+            }
+            auto hottest = monitor.load(self) - mean > _options.threshold
+                               ? directory.hottest(_options.max_migrations)
+                               : std::vector<typename Directory::key_type>();
+            directory.reset_heat();
+            if (hottest.empty()) {
+                return;
+            }
+            _busy = true;
+            (void)nil::actor::with_gate(_migrations, [this, &directory, &monitor, self, hottest = std::move(hottest)] {
+                return nil::actor::do_with(std::move(hottest), [&directory, &monitor, self](auto &keys) {
+                    return nil::actor::do_for_each(keys, [&directory, &monitor, self](auto &key) {
+                        // a failed migration leaves the key where it was
+                        return directory.migrate(key, monitor.place(self)).handle_exception([](std::exception_ptr) {});
+                    });
+                }).finally([this] { _busy = false; });
+            });
+        }
+
+    public:
+        rebalancer(nil::actor::sharded<Directory> &directory, nil::actor::sharded<shard_load_monitor> &monitor,
+                   rebalancer_options options = {}) :
+            _directory(directory),
+            _monitor(monitor), _options(options), _timer([this] { run(); }) {
+            _timer.arm_periodic(_options.period);
+        }
+
+        nil::actor::future<> stop() {
+            _timer.cancel();
+            return _migrations.close();
+        }
+    };
+}    // namespace actor_apps_lib
@@ -0,0 +1,581 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+
+#pragma once
+
+#include <nil/actor/core/core.hh>
+#include <nil/actor/core/file.hh>
+#include <nil/actor/core/fstream.hh>
+#include <nil/actor/core/gate.hh>
+#include <nil/actor/core/lowres_clock.hh>
+#include <nil/actor/core/semaphore.hh>
+#include <nil/actor/core/shared_ptr.hh>
+#include <nil/actor/core/sstring.hh>
+#include <nil/actor/core/timer-set.hh>
+#include <nil/actor/core/timer.hh>
+
+#include <nil/actor/actor_ref.hpp>
+
+#include <boost/intrusive/list.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+/// Actor apps lib namespace
+
+namespace actor_apps_lib {
+
+    /// \brief Shard-local timing wheel of one-shot callbacks
+    ///
+    /// Callbacks are kept in a timer_set, the bucketed timer wheel the memcached app expires items
+    /// with, driven by a single lowres_clock timer: scheduling and cancelling cost the same
+    /// whatever the number of pending callbacks, at the price of the clock's resolution of about
+    /// 10ms. Callbacks run from the timer and may schedule or cancel others.
+    class timing_wheel {
+    public:
+        using clock_type = nil::actor::lowres_clock;
+        /// Identifies a scheduled callback; 0 is never used, so it can stand for none.
+        using id_type = uint64_t;
+
+    private:
+        struct entry {
+            id_type id;
+            clock_type::time_point timeout;
+            std::function<void()> callback;
+            // taken off the wheel by expire(), about to run
+            bool expired = false;
+            boost::intrusive::list_member_hook<> _timer_link;
+
+            // needed by timer_set
+            clock_type::time_point get_timeout() const {
+                return timeout;
+            }
+
+            bool cancel() {
+                return false;
+            }
+        };
+
+        std::unordered_map<id_type, std::unique_ptr<entry>> _entries;
+        nil::actor::timer_set<entry, &entry::_timer_link> _wheel;
+        nil::actor::timer<clock_type> _timer;
+        id_type _next_id = 1;
+        bool _expiring = false;
+
+        void expire() {
+            _expiring = true;
+            auto expired = _wheel.expire(clock_type::now());
+            std::vector<id_type> due;
+            while (!expired.empty()) {
+                auto &e = *expired.begin();
+                expired.pop_front();
+                e.expired = true;
+                due.push_back(e.id);
+            }
+            for (auto id : due) {
+                // an earlier callback may have cancelled it
+                auto it = _entries.find(id);
+                if (it == _entries.end()) {
+                    continue;
+                }
+                auto callback = std::move(it->second->callback);
+                _entries.erase(it);
+                callback();
+            }
+            _expiring = false;
+            if (!_wheel.empty()) {
+                _timer.rearm(_wheel.get_next_timeout());
+            }
+        }
+
+    public:
+        timing_wheel() {
+            _timer.set_callback([this] { expire(); });
+        }
+
+        timing_wheel(const timing_wheel &) = delete;
+
+        ~timing_wheel() {
+            _timer.cancel();
+        }
+
+        /// Calls callback once at the given time, or right away if it has passed.
+        id_type schedule(clock_type::time_point at, std::function<void()> callback) {
+            auto id = _next_id++;
+            auto &e = *_entries.emplace(id, std::make_unique<entry>()).first->second;
+            e.id = id;
+            e.timeout = at;
+            e.callback = std::move(callback);
+            // expire() rearms the timer itself once it is done
+            if (_wheel.insert(e) && !_expiring) {
+                _timer.rearm(e.timeout);
+            }
+            return id;
+        }
+
+        /// Cancels a callback that hasn't run yet. Returns whether it hadn't.
+        bool cancel(id_type id) {
+            auto it = _entries.find(id);
+            if (it == _entries.end()) {
+                return false;
+            }
+            if (!it->second->expired) {
+                _wheel.remove(*it->second);
+            }
+            _entries.erase(it);
+            return true;
+        }
+
+        /// Cancels every pending callback.
+        void stop() {
+            _timer.cancel();
+            for (auto &[id, e] : _entries) {
+                if (!e->expired) {
+                    _wheel.remove(*e);
+                }
+            }
+            _entries.clear();
+        }
+
+        /// Callbacks pending.
+        size_t size() const noexcept {
+            return _entries.size();
+        }
+    };
+
+    /// \brief In-memory timers of virtual actors, tied to their activation
+    ///
+    /// A timer sends a message to an actor after a delay and then every period, instead of a
+    /// handler sleeping until it is time: a sleeping handler pins its actor, and keeps a
+    /// non-reentrant one from handling anything else until it wakes up. The message is sent by
+    /// the tick function given at registration, and the next tick is only scheduled once it has
+    /// been handled, so ticks of a slow handler don't pile up.
+    ///
+    /// Timers only live in memory, on the shard that registered them. Cancel the timers of a key
+    /// when it is deactivated, for instance from the on_deactivate() of an activation_directory,
+    /// and use a reminder_table for schedules that must outlive the activation or the process.
+    ///
+    /// Example:
+    /// \code
+    /// #include "../lib/actor_timers.hh"
+    /// ...
+    /// static thread_local actor_apps_lib::actor_timers<cart_actor> timers;
+    /// ...
+    /// timers.register_timer(key, "flush", std::chrono::seconds(1), std::chrono::seconds(1),
+    ///                       [](const cart_actor::KeyType &key) { return nil::actor::get<cart_actor>(key)->flush(); });
+    /// ...
+    /// static void cart_actor::on_deactivate(const KeyType &key, cart &c) {
+    ///     timers.cancel_all(key);
+    /// }
+    /// \endcode
+    template<typename Actor>
+    class actor_timers {
+    public:
+        using key_type = typename Actor::KeyType;
+        using clock_type = timing_wheel::clock_type;
+        using tick_type = std::function<nil::actor::future<>(const key_type &)>;
+
+        struct stats {
+            uint64_t ticks = 0;
+            // ticks whose message failed
+            uint64_t failed = 0;
+        };
+
+    private:
+        struct registration {
+            tick_type tick;
+            clock_type::duration period;
+            timing_wheel::id_type id = 0;
+            bool cancelled = false;
+        };
+
+        using registration_ptr = nil::actor::lw_shared_ptr<registration>;
+
+        timing_wheel _wheel;
+        std::unordered_map<key_type, std::unordered_map<nil::actor::sstring, registration_ptr>> _timers;
+        nil::actor::gate _ticks;
+        stats _stats;
+
+        void arm(const key_type &key, const nil::actor::sstring &name, registration_ptr r,
+                 clock_type::duration delay) {
+            r->id = _wheel.schedule(clock_type::now() + delay, [this, key, name, r] { fire(key, name, r); });
+        }
+
+        void forget(const key_type &key, const nil::actor::sstring &name) {
+            auto it = _timers.find(key);
+            it->second.erase(name);
+            if (it->second.empty()) {
+                _timers.erase(it);
+            }
+        }
+
+        void fire(const key_type &key, const nil::actor::sstring &name, registration_ptr r) {
+            _stats.ticks++;
+            if (r->period == clock_type::duration::zero()) {
+                r->cancelled = true;
+                forget(key, name);
+            }
+            if (_ticks.is_closed()) {
+                return;
+            }
+            (void)nil::actor::with_gate(_ticks, [this, key, name, r] {
+                return nil::actor::futurize_invoke(r->tick, key).then_wrapped([this, key, name, r](auto f) {
+                    if (f.failed()) {
+                        f.ignore_ready_future();
+                        _stats.failed++;
+                    }
+                    if (!r->cancelled && !_ticks.is_closed()) {
+                        arm(key, name, r, r->period);
+                    }
+                });
+            });
+        }
+
+    public:
+        actor_timers() = default;
+
+        actor_timers(const actor_timers &) = delete;
+
+        /// Calls tick with the key after due, then every period until cancelled; a zero period
+        /// makes a one-shot timer. Replaces the timer of the key with the same name, if any.
+        template<typename Tick>
+        void register_timer(const key_type &key, nil::actor::sstring name, clock_type::duration due,
+                            clock_type::duration period, Tick tick) {
+            cancel_timer(key, name);
+            auto r = nil::actor::make_lw_shared<registration>();
+            r->tick = std::move(tick);
+            r->period = period;
+            _timers[key].emplace(name, r);
+            arm(key, name, std::move(r), due);
+        }
+
+        /// Cancels a timer. A tick already sent is still handled. Returns whether it was registered.
+        bool cancel_timer(const key_type &key, const nil::actor::sstring &name) {
+            auto it = _timers.find(key);
+            if (it == _timers.end()) {
+                return false;
+            }
+            auto timer = it->second.find(name);
+            if (timer == it->second.end()) {
+                return false;
+            }
+            timer->second->cancelled = true;
+            _wheel.cancel(timer->second->id);
+            forget(key, name);
+            return true;
+        }
+
+        /// Cancels every timer of the key; call it when the key is deactivated. Returns their number.
+        size_t cancel_all(const key_type &key) {
+            auto it = _timers.find(key);
+            if (it == _timers.end()) {
+                return 0;
+            }
+            auto n = it->second.size();
+            for (auto &[name, r] : it->second) {
+                r->cancelled = true;
+                _wheel.cancel(r->id);
+            }
+            _timers.erase(it);
+            return n;
+        }
+
+        /// Cancels every timer and waits for the ticks in progress; call it before the reactor exits.
+        nil::actor::future<> stop() {
+            _wheel.stop();
+            for (auto &[key, timers] : _timers) {
+                for (auto &[name, r] : timers) {
+                    r->cancelled = true;
+                }
+            }
+            _timers.clear();
+            return _ticks.close();
+        }
+
+        /// Timers registered on the shard.
+        size_t size() const noexcept {
+            size_t n = 0;
+            for (auto &[key, timers] : _timers) {
+                n += timers.size();
+            }
+            return n;
+        }
+
+        const stats &get_stats() const noexcept {
+            return _stats;
+        }
+    };
+
+    /// \brief Durable reminders of virtual actors, persisted to a local file
+    ///
+    /// A reminder sends receive_reminder(name) to an actor at a given time and then every
+    /// period, whether the actor is active or not, and survives restarts: every change rewrites
+    /// the reminder file (into a temporary file that is flushed and renamed over it), and start()
+    /// reloads it. Reminders that came due while the process was down fire right after start(),
+    /// then go on with their period. Due times are only persisted on changes, so a periodic
+    /// reminder may fire once more than expected after a restart; handlers must tolerate that.
+    ///
+    /// The actor declares nil::actor::future<> receive_reminder(nil::actor::sstring name) in
+    /// ACTOR_DEFINE_ACTOR. Keys are stored with boost::lexical_cast, so KeyType must be streamable
+    /// both ways and must not print a newline; names must not contain white space.
+    ///
+    /// Reminders fire from the shard that registered them, on its timing wheel. Keep one table per
+    /// shard, each with its own file, for instance named after this_shard_id().
+    ///
+    /// Example:
+    /// \code
+    /// #include "../lib/actor_timers.hh"
+    /// ...
+    /// static thread_local std::unique_ptr<actor_apps_lib::reminder_table<cart_actor>> reminders;
+    /// ...
+    /// reminders = std::make_unique<actor_apps_lib::reminder_table<cart_actor>>(
+    ///     nil::actor::format("reminders-{}", nil::actor::this_shard_id()));
+    /// return reminders->start().then([key] {
+    ///     return reminders->register_reminder(key, "expire", std::chrono::hours(24), std::chrono::hours(24));
+    /// });
+    /// \endcode
+    template<typename Actor>
+    class reminder_table {
+    public:
+        using key_type = typename Actor::KeyType;
+        using clock_type = timing_wheel::clock_type;
+        // due times are persisted, so they have to be in wall-clock time
+        using wall_clock = std::chrono::system_clock;
+
+        struct stats {
+            uint64_t fired = 0;
+            // reminders whose message failed
+            uint64_t failed = 0;
+            uint64_t writes = 0;
+            uint64_t write_errors = 0;
+        };
+
+    private:
+        struct reminder {
+            wall_clock::time_point due;
+            wall_clock::duration period;
+            timing_wheel::id_type id = 0;
+        };
+
+        nil::actor::sstring _path;
+        timing_wheel _wheel;
+        std::unordered_map<key_type, std::unordered_map<nil::actor::sstring, reminder>> _reminders;
+        // writes of the file, one at a time
+        nil::actor::semaphore _write_lock {1};
+        nil::actor::gate _deliveries;
+        stats _stats;
+
+        void schedule(const key_type &key, const nil::actor::sstring &name, reminder &r) {
+            auto delay = std::max(r.due - wall_clock::now(), wall_clock::duration::zero());
+            r.id = _wheel.schedule(clock_type::now() + std::chrono::duration_cast<clock_type::duration>(delay),
+                                   [this, key, name] { fire(key, name); });
+        }
+
+        void forget(const key_type &key, const nil::actor::sstring &name) {
+            auto it = _reminders.find(key);
+            it->second.erase(name);
+            if (it->second.empty()) {
+                _reminders.erase(it);
+            }
+        }
+
+        void fire(const key_type &key, const nil::actor::sstring &name) {
+            // replacing or unregistering a reminder cancels its callback, so it is still registered
+            auto &r = _reminders[key][name];
+            _stats.fired++;
+            bool one_shot = r.period == wall_clock::duration::zero();
+            if (one_shot) {
+                forget(key, name);
+            } else {
+                r.due = wall_clock::now() + r.period;
+                schedule(key, name, r);
+            }
+            if (_deliveries.is_closed()) {
+                return;
+            }
+            (void)nil::actor::with_gate(_deliveries, [this, key, name, one_shot] {
+                auto delivery = nil::actor::get<Actor>(key)->receive_reminder(name).handle_exception(
+                    [this](std::exception_ptr) { _stats.failed++; });
+                if (!one_shot) {
+                    return delivery;
+                }
+                // write_errors counts a failed write
+                return std::move(delivery).then(
+                    [this] { return persist().handle_exception([](std::exception_ptr) {}); });
+            });
+        }
+
+        nil::actor::sstring serialize() const {
+            std::ostringstream out;
+            for (auto &[key, reminders] : _reminders) {
+                for (auto &[name, r] : reminders) {
+                    out << name << ' '
+                        << std::chrono::duration_cast<std::chrono::milliseconds>(r.due.time_since_epoch()).count()
+                        << ' ' << std::chrono::duration_cast<std::chrono::milliseconds>(r.period).count() << ' '
+                        << boost::lexical_cast<std::string>(key) << '\n';
+                }
+            }
+            auto text = out.str();
+            return nil::actor::sstring(text.data(), text.size());
+        }
+
+        void parse(const std::string &text) {
+            std::istringstream in(text);
+            std::string line;
+            while (std::getline(in, line)) {
+                std::istringstream fields(line);
+                std::string name;
+                int64_t due;
+                int64_t period;
+                if (!(fields >> name >> due >> period) || fields.get() != ' ') {
+                    throw std::runtime_error(fmt::format("malformed reminder file {}", _path));
+                }
+                std::string key;
+                std::getline(fields, key);
+                auto &r = _reminders[boost::lexical_cast<key_type>(key)][name];
+                r.due = wall_clock::time_point(std::chrono::milliseconds(due));
+                r.period = std::chrono::milliseconds(period);
+            }
+            for (auto &[key, reminders] : _reminders) {
+                for (auto &[name, r] : reminders) {
+                    schedule(key, name, r);
+                }
+            }
+        }
+
+        nil::actor::sstring directory() const {
+            auto dir = std::filesystem::path(std::string(_path)).parent_path();
+            return dir.empty() ? nil::actor::sstring(".") : nil::actor::sstring(dir.c_str());
+        }
+
+        // Writes the reminders as they are when the write starts, so writes queued behind it
+        // include later changes.
+        nil::actor::future<> persist() {
+            return nil::actor::with_semaphore(_write_lock, 1, [this] {
+                _stats.writes++;
+                auto tmp = _path + ".tmp";
+                return nil::actor::open_file_dma(tmp, nil::actor::open_flags::wo | nil::actor::open_flags::create |
+                                                          nil::actor::open_flags::truncate)
+                    .then([](nil::actor::file f) { return nil::actor::make_file_output_stream(std::move(f)); })
+                    .then([data = serialize()](nil::actor::output_stream<char> out) mutable {
+                        return nil::actor::do_with(std::move(out), std::move(data), [](auto &out, auto &data) {
+                            return out.write(data).then([&out] { return out.flush(); }).finally([&out] {
+                                return out.close();
+                            });
+                        });
+                    })
+                    .then([this, tmp] { return nil::actor::rename_file(tmp, _path); })
+                    .then([this] { return nil::actor::sync_directory(directory()); })
+                    .handle_exception([this](std::exception_ptr ep) {
+                        _stats.write_errors++;
+                        return nil::actor::make_exception_future<>(ep);
+                    });
+            });
+        }
+
+        static bool valid_name(const nil::actor::sstring &name) {
+            return !name.empty() &&
+                   std::none_of(name.begin(), name.end(), [](char c) { return std::isspace((unsigned char)c); });
+        }
+
+    public:
+        explicit reminder_table(nil::actor::sstring path) : _path(std::move(path)) {
+        }
+
+        reminder_table(const reminder_table &) = delete;
+
+        /// Loads the reminders persisted in the file, if it exists, and schedules them.
+        nil::actor::future<> start() {
+            return nil::actor::file_exists(_path).then([this](bool exists) {
+                if (!exists) {
+                    return nil::actor::make_ready_future<>();
+                }
+                return nil::actor::with_file(
+                    nil::actor::open_file_dma(_path, nil::actor::open_flags::ro), [this](nil::actor::file &f) {
+                        return f.size()
+                            .then([&f](uint64_t size) { return f.dma_read_bulk<char>(0, size); })
+                            .then([this](nil::actor::temporary_buffer<char> data) {
+                                parse(std::string(data.get(), data.size()));
+                            });
+                    });
+            });
+        }
+
+        /// Sends receive_reminder(name) to the actor of the key after due, then every period; a
+        /// zero period makes a one-shot reminder. Replaces the reminder of the key with the same
+        /// name, if any. Resolves once the reminder is persisted.
+        nil::actor::future<> register_reminder(const key_type &key, nil::actor::sstring name, wall_clock::duration due,
+                                               wall_clock::duration period) {
+            if (!valid_name(name)) {
+                return nil::actor::make_exception_future<>(
+                    std::invalid_argument("reminder names must be non-empty and free of white space"));
+            }
+            auto &r = _reminders[key][name];
+            _wheel.cancel(r.id);
+            r.due = wall_clock::now() + due;
+            r.period = period;
+            schedule(key, name, r);
+            return persist();
+        }
+
+        /// Unregisters a reminder. Resolves to whether it was registered, once that is persisted.
+        nil::actor::future<bool> unregister_reminder(const key_type &key, const nil::actor::sstring &name) {
+            auto it = _reminders.find(key);
+            if (it == _reminders.end() || !it->second.count(name)) {
+                return nil::actor::make_ready_future<bool>(false);
+            }
+            _wheel.cancel(it->second[name].id);
+            forget(key, name);
+            return persist().then([] { return true; });
+        }
+
+        /// Stops firing reminders, and waits for the messages and writes in progress; call it
+        /// before the reactor exits. The file keeps the reminders for the next start().
+        nil::actor::future<> stop() {
+            _wheel.stop();
+            return _deliveries.close().then([this] { return nil::actor::with_semaphore(_write_lock, 1, [] {}); });
+        }
+
+        /// Reminders registered on the shard.
+        size_t size() const noexcept {
+            return _wheel.size();
+        }
+
+        const stats &get_stats() const noexcept {
+            return _stats;
+        }
+    };
+}    // namespace actor_apps_lib
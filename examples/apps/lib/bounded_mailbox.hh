@@ -0,0 +1,254 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+
+#pragma once
+
+#include <nil/actor/core/future-util.hh>
+#include <nil/actor/core/future.hh>
+#include <nil/actor/core/gate.hh>
+#include <nil/actor/core/loop.hh>
+#include <nil/actor/core/semaphore.hh>
+#include <nil/actor/core/shared_ptr.hh>
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "latency_histogram.hh"
+
+/// Actor apps lib namespace
+
+namespace actor_apps_lib {
+
+    enum class overflow_policy {
+        /// the sender's future waits for room in the mailbox
+        wait,
+        /// the oldest queued message fails with message_dropped to make room
+        drop_oldest,
+        /// the new message fails with mailbox_full
+        fail,
+    };
+
+    class mailbox_full : public std::runtime_error {
+    public:
+        mailbox_full() : std::runtime_error("mailbox full") {
+        }
+    };
+
+    class message_dropped : public std::runtime_error {
+    public:
+        message_dropped() : std::runtime_error("message dropped from a full mailbox") {
+        }
+    };
+
+    /// \brief Mailbox running one message at a time, holding at most capacity waiting ones
+    ///
+    /// non_reentrant_actor queues messages for a busy actor without bound, so a slow actor
+    /// keeps accumulating them. An actor that posts its handlers through a bounded mailbox
+    /// instead (and is itself left reentrant) gets the same one-at-a-time execution, with the
+    /// overflow policy deciding what happens to messages beyond capacity. The depth of the
+    /// mailbox is recorded every time a message is posted.
+    ///
+    /// Messages posted with post_shared() are readers: consecutive readers at the head of the
+    /// mailbox run concurrently, while messages posted with post() run alone. post_handler()
+    /// picks between the two by the constness of the handler, so read-only handlers of an actor
+    /// interleave and the others get exclusive access. Messages still start in the order they
+    /// were posted, so a waiting writer holds back the readers posted after it.
+    ///
+    /// Example:
+    /// \code
+    /// #include "../lib/bounded_mailbox.hh"
+    /// ...
+    /// class account : public nil::actor::actor<account> {
+    ///     actor_apps_lib::bounded_mailbox _mailbox {64, actor_apps_lib::overflow_policy::fail};
+    /// public:
+    ///     nil::actor::future<> deposit(int amount) {
+    ///         return _mailbox.post([this, amount] { return do_deposit(amount); });
+    ///     }
+    ///     ACTOR_DEFINE_ACTOR(account, (deposit));
+    /// };
+    /// \endcode
+    class bounded_mailbox {
+    public:
+        struct stats {
+            uint64_t posted = 0;
+            uint64_t waited = 0;
+            uint64_t dropped = 0;
+            uint64_t rejected = 0;
+            /// Messages waiting when a message is posted, the new one included.
+            latency_histogram depths;
+        };
+
+    private:
+        struct message {
+            std::function<nil::actor::future<>()> run;
+            std::function<void(std::exception_ptr)> fail;
+            bool shared;
+        };
+
+        overflow_policy _policy;
+        // one unit per free place in the mailbox
+        nil::actor::semaphore _room;
+        std::deque<message> _messages;
+        bool _running = false;
+        nil::actor::gate _gate;
+        stats _stats;
+
+        void enqueue(message m) {
+            // a post that waited for room may get it after close()
+            if (_gate.is_closed()) {
+                _room.signal(1);
+                m.fail(std::make_exception_ptr(nil::actor::gate_closed_exception()));
+                return;
+            }
+            _messages.push_back(std::move(m));
+            _stats.depths.record(_messages.size());
+            if (!_running) {
+                _running = true;
+                (void)nil::actor::with_gate(_gate, [this] {
+                    // The loop is marked stopped in the same step that sees the mailbox empty, so a
+                    // message enqueued by the continuation of a waiting post starts a new loop
+                    // instead of landing behind one that has already decided to stop.
+                    auto stop = [this] {
+                        _running = !_messages.empty();
+                        return !_running;
+                    };
+                    return nil::actor::do_until(stop, [this] {
+                        if (!_messages.front().shared) {
+                            auto m = std::move(_messages.front());
+                            _messages.pop_front();
+                            _room.signal(1);
+                            return m.run();
+                        }
+                        std::vector<nil::actor::future<>> readers;
+                        while (!_messages.empty() && _messages.front().shared) {
+                            readers.push_back(_messages.front().run());
+                            _messages.pop_front();
+                            _room.signal(1);
+                        }
+                        return nil::actor::when_all(readers.begin(), readers.end()).discard_result();
+                    });
+                });
+            }
+        }
+
+        template<typename Func>
+        auto do_post(Func func, bool shared) {
+            using futurator = nil::actor::futurize<std::invoke_result_t<Func &>>;
+            auto pr = nil::actor::make_lw_shared<typename futurator::promise_type>();
+            auto f = pr->get_future();
+            _stats.posted++;
+            message m {[pr, func = std::move(func)]() mutable {
+                           return futurator::invoke(func).then_wrapped(
+                               [pr](auto f) { f.forward_to(std::move(*pr)); });
+                       },
+                       [pr](std::exception_ptr ex) { pr->set_exception(std::move(ex)); }, shared};
+            if (_gate.is_closed()) {
+                pr->set_exception(nil::actor::gate_closed_exception());
+                return f;
+            }
+            if (_room.try_wait(1)) {
+                enqueue(std::move(m));
+                return f;
+            }
+            switch (_policy) {
+                case overflow_policy::fail:
+                    _stats.rejected++;
+                    pr->set_exception(mailbox_full());
+                    break;
+                case overflow_policy::drop_oldest:
+                    if (!_messages.empty()) {
+                        // the room of the dropped message goes to the new one
+                        _messages.front().fail(std::make_exception_ptr(message_dropped()));
+                        _messages.pop_front();
+                        _stats.dropped++;
+                        enqueue(std::move(m));
+                    } else {
+                        _stats.rejected++;
+                        pr->set_exception(mailbox_full());
+                    }
+                    break;
+                case overflow_policy::wait:
+                    _stats.waited++;
+                    (void)_room.wait(1).then_wrapped([this, m = std::move(m)](nil::actor::future<> f) mutable {
+                        if (f.failed()) {
+                            m.fail(f.get_exception());
+                        } else {
+                            enqueue(std::move(m));
+                        }
+                    });
+                    break;
+            }
+            return f;
+        }
+
+    public:
+        bounded_mailbox(size_t capacity, overflow_policy policy = overflow_policy::wait) :
+            _policy(policy), _room(std::max<size_t>(capacity, 1)) {
+        }
+
+        /// Runs func alone once the messages posted before it are done, and resolves to its result,
+        /// or fails as the overflow policy says if the mailbox is full. func must be copyable.
+        template<typename Func>
+        auto post(Func func) {
+            return do_post(std::move(func), false);
+        }
+
+        /// Like post(), but func may run concurrently with other messages posted with post_shared().
+        template<typename Func>
+        auto post_shared(Func func) {
+            return do_post(std::move(func), true);
+        }
+
+        /// Posts a call of a handler of the actor: a const handler with post_shared(), any other with
+        /// post(). The arguments are copied into the message.
+        template<typename Actor, typename Ret, typename... Params, typename... Args>
+        auto post_handler(const Actor *actor, Ret (Actor::*handler)(Params...) const, Args... args) {
+            return post_shared([actor, handler, args...] { return (actor->*handler)(args...); });
+        }
+
+        template<typename Actor, typename Ret, typename... Params, typename... Args>
+        auto post_handler(Actor *actor, Ret (Actor::*handler)(Params...), Args... args) {
+            return post([actor, handler, args...] { return (actor->*handler)(args...); });
+        }
+
+        /// Fails messages still waiting for room, and waits for the queued ones to run.
+        nil::actor::future<> close() {
+            _room.broken();
+            return _gate.close();
+        }
+
+        size_t depth() const noexcept {
+            return _messages.size();
+        }
+
+        const stats &get_stats() const noexcept {
+            return _stats;
+        }
+    };
+}    // namespace actor_apps_lib
@@ -0,0 +1,104 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#pragma once
+
+#include <yaml-cpp/yaml.h>
+
+#include <boost/lexical_cast.hpp>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+/// Actor apps lib namespace
+
+namespace actor_apps_lib {
+
+    /// \brief Size in bytes read from an app's YAML configuration
+    ///
+    /// Written as a plain number of bytes, or with a kB, MB or GB suffix for binary multiples, for
+    /// example `4096`, `4kB` or `100MB`.
+    ///
+    /// Example:
+    /// \code
+    /// #include "../lib/byte_size.hh"
+    /// ...
+    /// auto size = node["data_size"].as<actor_apps_lib::byte_size>().size;
+    /// \endcode
+    struct byte_size {
+        uint64_t size;
+
+        /// Parses a size, throwing std::invalid_argument if it is empty, has an unknown suffix, or
+        /// doesn't fit in 64 bits.
+        static byte_size parse(std::string str) {
+            auto invalid = [&str](const char *why) {
+                return std::invalid_argument("invalid size '" + str + "': " + why);
+            };
+            auto number = str;
+            unsigned shift = 0;
+            if (!number.empty() && number.back() == 'B') {
+                number.pop_back();
+                if (number.empty()) {
+                    throw invalid("no number");
+                }
+                switch (number.back()) {
+                    case 'k':
+                        shift = 10;
+                        break;
+                    case 'M':
+                        shift = 20;
+                        break;
+                    case 'G':
+                        shift = 30;
+                        break;
+                    default:
+                        throw invalid("unknown suffix, expected kB, MB or GB");
+                }
+                number.pop_back();
+            }
+            if (number.empty()) {
+                throw invalid("no number");
+            }
+            uint64_t value;
+            if (!boost::conversion::try_lexical_convert(number, value)) {
+                throw invalid("not a number, or an unknown suffix");
+            }
+            if (value > (UINT64_MAX >> shift)) {
+                throw invalid("too large");
+            }
+            return byte_size {value << shift};
+        }
+    };
+}    // namespace actor_apps_lib
+
+namespace YAML {
+    template<>
+    struct convert<actor_apps_lib::byte_size> {
+        static bool decode(const Node &node, actor_apps_lib::byte_size &bs) {
+            bs = actor_apps_lib::byte_size::parse(node.as<std::string>());
+            return true;
+        }
+    };
+}    // namespace YAML
@@ -0,0 +1,299 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#pragma once
+
+#include <nil/actor/core/file.hh>
+#include <nil/actor/core/future.hh>
+#include <nil/actor/core/io_intent.hh>
+#include <nil/actor/core/shared_ptr.hh>
+#include <nil/actor/core/temporary_buffer.hh>
+
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+/// Actor apps lib namespace
+
+namespace actor_apps_lib {
+
+    /// \brief Merges adjacent DMA requests queued on a file
+    ///
+    /// At most max_in_flight I/Os are submitted to the file at a time. Requests arriving while
+    /// all of them are busy are queued, and when a slot frees up, the oldest queued request is
+    /// merged with every queued request of the same direction adjacent to it (and, for reads,
+    /// overlapping it), up to max_merge_size bytes and max_iov requests. Adjacent requests are submitted as one
+    /// vectored dma_read()/dma_write() straight into the callers' buffers; overlapping reads go
+    /// through a bounce buffer. Completions are split back so every caller sees the bytes of its
+    /// own range, as with a plain dma_read()/dma_write().
+    ///
+    /// Requests may carry a tag chosen by the caller, such as the kind of operation they belong to;
+    /// tag_stats() breaks the statistics down by tag, and a merged I/O counts for the tag of the
+    /// oldest request in it.
+    ///
+    /// Requests may be attached to an io_intent, and only requests with the same intent are merged.
+    /// cancel() fails the queued requests of an intent with cancelled_error right away, so they
+    /// never take an I/O slot, and cancels the intent, which aborts its submitted I/Os that the
+    /// kernel hasn't started yet.
+    ///
+    /// As with any DMA, buffers, positions and lengths have to be aligned to the file's DMA
+    /// alignment. The object must outlive all requests made through it.
+    class coalescing_file {
+    public:
+        // Most requests merged into one I/O, as a vectored I/O can't take more iovecs than that.
+        static constexpr size_t max_iov = IOV_MAX;
+
+        struct stats {
+            uint64_t requests = 0;
+            // I/Os actually submitted; requests - ios were merged into another one
+            uint64_t ios = 0;
+            // requests failed by cancellation, queued or submitted, and their size
+            uint64_t cancelled = 0;
+            uint64_t cancelled_bytes = 0;
+
+            uint64_t merged() const noexcept {
+                return requests - ios;
+            }
+        };
+
+    private:
+        struct request {
+            bool write;
+            uint64_t pos;
+            char *buf;
+            size_t len;
+            nil::actor::io_intent *intent;
+            unsigned tag;
+            nil::actor::promise<size_t> pr;
+
+            uint64_t end() const noexcept {
+                return pos + len;
+            }
+        };
+
+        nil::actor::file _file;
+        nil::actor::io_priority_class _pc;
+        unsigned _max_in_flight;
+        size_t _max_merge_size;
+        unsigned _in_flight = 0;
+        std::list<request> _queue;
+        stats _reads;
+        stats _writes;
+        std::unordered_map<unsigned, stats> _tags;
+
+        // Moves the oldest queued request and everything it can be merged with into a group.
+        std::vector<request> take_group() {
+            std::vector<request> group;
+            group.push_back(std::move(_queue.front()));
+            _queue.pop_front();
+            auto write = group.front().write;
+            auto start = group.front().pos;
+            auto end = group.front().end();
+            bool extended = true;
+            while (extended && group.size() < max_iov) {
+                extended = false;
+                for (auto it = _queue.begin(); it != _queue.end(); ++it) {
+                    if (it->write != write || it->intent != group.front().intent) {
+                        continue;
+                    }
+                    // writes only merge when exactly adjacent, overlapping ones keep their order
+                    bool mergeable = write ? (it->pos == end || it->end() == start)
+                                           : (it->pos <= end && it->end() >= start);
+                    auto new_start = std::min(start, it->pos);
+                    auto new_end = std::max(end, it->end());
+                    if (mergeable && new_end - new_start <= _max_merge_size) {
+                        start = new_start;
+                        end = new_end;
+                        group.push_back(std::move(*it));
+                        _queue.erase(it);
+                        extended = true;
+                        break;
+                    }
+                }
+            }
+            std::sort(group.begin(), group.end(), [](auto &a, auto &b) { return a.pos < b.pos; });
+            return group;
+        }
+
+        static bool contiguous(const std::vector<request> &group) {
+            for (size_t i = 1; i < group.size(); ++i) {
+                if (group[i].pos != group[i - 1].end()) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        nil::actor::future<size_t> submit(std::vector<request> &group) {
+            auto &first = group.front();
+            if (group.size() == 1) {
+                return first.write ? _file.dma_write(first.pos, first.buf, first.len, _pc, first.intent)
+                                   : _file.dma_read(first.pos, first.buf, first.len, _pc, first.intent);
+            }
+            if (contiguous(group)) {
+                std::vector<iovec> iov;
+                for (auto &r : group) {
+                    iov.push_back(iovec {r.buf, r.len});
+                }
+                return first.write ? _file.dma_write(first.pos, std::move(iov), _pc, first.intent)
+                                   : _file.dma_read(first.pos, std::move(iov), _pc, first.intent);
+            }
+            // overlapping reads
+            auto start = first.pos;
+            auto end = std::max_element(group.begin(), group.end(), [](auto &a, auto &b) {
+                           return a.end() < b.end();
+                       })->end();
+            return _file.dma_read_bulk<char>(start, end - start, _pc, first.intent)
+                .then([&group, start](nil::actor::temporary_buffer<char> data) {
+                    // group is kept alive by dispatch() until the I/O completes
+                    for (auto &r : group) {
+                        auto offset = r.pos - start;
+                        if (offset < data.size()) {
+                            std::memcpy(r.buf, data.get() + offset, std::min(r.len, data.size() - offset));
+                        }
+                    }
+                    return size_t(data.size());
+                });
+        }
+
+        void dispatch() {
+            while (_in_flight < _max_in_flight && !_queue.empty()) {
+                auto leader = _queue.front().tag;
+                auto group = take_group();
+                auto &st = group.front().write ? _writes : _reads;
+                st.requests += group.size();
+                st.ios++;
+                for (auto &r : group) {
+                    _tags[r.tag].requests++;
+                }
+                _tags[leader].ios++;
+                _in_flight++;
+                auto start = group.front().pos;
+                auto g = nil::actor::make_lw_shared<std::vector<request>>(std::move(group));
+                (void)submit(*g).then_wrapped([this, g, start](nil::actor::future<size_t> f) {
+                    _in_flight--;
+                    if (f.failed()) {
+                        auto ex = f.get_exception();
+                        if (is_cancellation(ex)) {
+                            for (auto &r : *g) {
+                                count_cancelled(r);
+                            }
+                        }
+                        for (auto &r : *g) {
+                            r.pr.set_exception(ex);
+                        }
+                    } else {
+                        // every request gets the part of the transfer that covers its range
+                        auto done = start + f.get0();
+                        for (auto &r : *g) {
+                            r.pr.set_value(done > r.pos ? std::min<uint64_t>(done - r.pos, r.len) : 0);
+                        }
+                    }
+                    dispatch();
+                });
+            }
+        }
+
+        static bool is_cancellation(const std::exception_ptr &ex) {
+            try {
+                std::rethrow_exception(ex);
+            } catch (const nil::actor::cancelled_error &) {
+                return true;
+            } catch (...) {
+                return false;
+            }
+        }
+
+        void count_cancelled(const request &r) {
+            for (auto st : {&(r.write ? _writes : _reads), &_tags[r.tag]}) {
+                st->cancelled++;
+                st->cancelled_bytes += r.len;
+            }
+        }
+
+        nil::actor::future<size_t> enqueue(bool write, uint64_t pos, char *buf, size_t len,
+                                           nil::actor::io_intent *intent, unsigned tag) {
+            _queue.push_back(request {write, pos, buf, len, intent, tag, nil::actor::promise<size_t>()});
+            auto f = _queue.back().pr.get_future();
+            dispatch();
+            return f;
+        }
+
+    public:
+        coalescing_file(nil::actor::file f, unsigned max_in_flight, size_t max_merge_size = 1 << 20,
+                        const nil::actor::io_priority_class &pc = nil::actor::default_priority_class()) :
+            _file(std::move(f)),
+            _pc(pc), _max_in_flight(std::max(max_in_flight, 1u)), _max_merge_size(max_merge_size) {
+        }
+
+        coalescing_file(const coalescing_file &) = delete;
+
+        nil::actor::future<size_t> dma_read(uint64_t pos, char *buf, size_t len,
+                                            nil::actor::io_intent *intent = nullptr, unsigned tag = 0) {
+            return enqueue(false, pos, buf, len, intent, tag);
+        }
+
+        nil::actor::future<size_t> dma_write(uint64_t pos, const char *buf, size_t len,
+                                             nil::actor::io_intent *intent = nullptr, unsigned tag = 0) {
+            return enqueue(true, pos, const_cast<char *>(buf), len, intent, tag);
+        }
+
+        /// Cancels all requests attached to the intent, both queued and submitted ones.
+        /// Returns the number of bytes of the queued requests removed from the queue.
+        uint64_t cancel(nil::actor::io_intent &intent) {
+            uint64_t bytes = 0;
+            for (auto it = _queue.begin(); it != _queue.end();) {
+                if (it->intent != &intent) {
+                    ++it;
+                    continue;
+                }
+                count_cancelled(*it);
+                bytes += it->len;
+                it->pr.set_exception(nil::actor::cancelled_error());
+                it = _queue.erase(it);
+            }
+            intent.cancel();
+            return bytes;
+        }
+
+        const stats &read_stats() const noexcept {
+            return _reads;
+        }
+
+        const stats &write_stats() const noexcept {
+            return _writes;
+        }
+
+        /// Statistics of the requests with the given tag, reads and writes together.
+        stats tag_stats(unsigned tag) const {
+            auto it = _tags.find(tag);
+            return it == _tags.end() ? stats() : it->second;
+        }
+    };
+}    // namespace actor_apps_lib
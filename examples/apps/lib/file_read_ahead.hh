@@ -0,0 +1,299 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#pragma once
+
+#include <nil/actor/core/file.hh>
+#include <nil/actor/core/future.hh>
+#include <nil/actor/core/iostream.hh>
+#include <nil/actor/core/shared_future.hh>
+#include <nil/actor/core/shared_ptr.hh>
+#include <nil/actor/core/temporary_buffer.hh>
+
+#include <deque>
+#include <limits>
+#include <list>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+/// Actor apps lib namespace
+
+namespace actor_apps_lib {
+
+    /// \brief Shard-local LRU cache of fixed-size blocks of one file
+    ///
+    /// Blocks are the aligned buffers read by a read-ahead stream, and are handed out with
+    /// temporary_buffer::share(), so every stream reading a cached block gets it without a copy
+    /// or a read. Streams missing a block that another one is already reading wait for that read
+    /// instead of reading the block again. Share one instance between the streams of a file on the
+    /// same shard.
+    class file_block_cache {
+        struct entry {
+            nil::actor::temporary_buffer<char> block;
+            std::list<uint64_t>::iterator lru;
+        };
+
+        // a block being read; the block is set before loaded resolves
+        struct load {
+            nil::actor::shared_promise<> loaded;
+            nil::actor::temporary_buffer<char> block;
+        };
+
+        size_t _block_size;
+        size_t _capacity;
+        std::unordered_map<uint64_t, entry> _blocks;
+        // most recently used first
+        std::list<uint64_t> _lru;
+        std::unordered_map<uint64_t, nil::actor::lw_shared_ptr<load>> _loading;
+        uint64_t _hits = 0;
+        uint64_t _misses = 0;
+        uint64_t _joined = 0;
+
+    public:
+        file_block_cache(size_t block_size, size_t capacity_bytes) :
+            _block_size(block_size), _capacity(std::max<size_t>(capacity_bytes / block_size, 1)) {
+        }
+
+        size_t block_size() const noexcept {
+            return _block_size;
+        }
+
+        std::optional<nil::actor::temporary_buffer<char>> get(uint64_t index) {
+            auto it = _blocks.find(index);
+            if (it == _blocks.end()) {
+                _misses++;
+                return std::nullopt;
+            }
+            _hits++;
+            _lru.splice(_lru.begin(), _lru, it->second.lru);
+            return it->second.block.share();
+        }
+
+        void put(uint64_t index, nil::actor::temporary_buffer<char> block) {
+            auto it = _blocks.find(index);
+            if (it != _blocks.end()) {
+                it->second.block = std::move(block);
+                _lru.splice(_lru.begin(), _lru, it->second.lru);
+                return;
+            }
+            if (_blocks.size() == _capacity) {
+                _blocks.erase(_lru.back());
+                _lru.pop_back();
+            }
+            _lru.push_front(index);
+            _blocks.emplace(index, entry {std::move(block), _lru.begin()});
+        }
+
+        /// Returns the block from the cache, or else from the read of it already in flight, or else
+        /// reads it with read(), which returns a future of the block, and caches it. A failed read
+        /// fails every caller waiting for it, and isn't cached. The cache must be kept alive until
+        /// the returned future resolves.
+        template<typename Read>
+        nil::actor::future<nil::actor::temporary_buffer<char>> get_or_read(uint64_t index, Read read) {
+            if (auto block = get(index)) {
+                return nil::actor::make_ready_future<nil::actor::temporary_buffer<char>>(std::move(*block));
+            }
+            auto it = _loading.find(index);
+            if (it != _loading.end()) {
+                _joined++;
+                auto l = it->second;
+                return l->loaded.get_shared_future().then([l] { return l->block.share(); });
+            }
+            auto l = nil::actor::make_lw_shared<load>();
+            _loading.emplace(index, l);
+            return nil::actor::futurize_invoke(read).then_wrapped(
+                [this, index, l](nil::actor::future<nil::actor::temporary_buffer<char>> f) {
+                    _loading.erase(index);
+                    if (f.failed()) {
+                        auto ex = f.get_exception();
+                        l->loaded.set_exception(ex);
+                        return nil::actor::make_exception_future<nil::actor::temporary_buffer<char>>(std::move(ex));
+                    }
+                    auto block = f.get0();
+                    put(index, block.share());
+                    l->block = block.share();
+                    l->loaded.set_value();
+                    return nil::actor::make_ready_future<nil::actor::temporary_buffer<char>>(std::move(block));
+                });
+        }
+
+        uint64_t hits() const noexcept {
+            return _hits;
+        }
+
+        /// Lookups that didn't find the block cached, including those that joined a read in flight.
+        uint64_t misses() const noexcept {
+            return _misses;
+        }
+
+        /// Misses that waited for a read of the block already in flight rather than reading it.
+        uint64_t joined() const noexcept {
+            return _joined;
+        }
+    };
+
+    struct read_ahead_options {
+        /// Size of every read; a multiple of the file's DMA alignment.
+        size_t buffer_size = 128 << 10;
+        /// Upper bound of reads in flight once the stream has proven sequential.
+        unsigned max_read_ahead = 8;
+        /// Optional block cache, shared with other streams on the same file.
+        nil::actor::lw_shared_ptr<file_block_cache> cache;
+        nil::actor::io_priority_class io_priority_class = nil::actor::default_priority_class();
+    };
+
+    /// \brief File data source with adaptive read-ahead
+    ///
+    /// Starts with one read in flight and doubles the window, up to max_read_ahead, every time
+    /// as many buffers as the window holds have been consumed without a skip. A skip drops the
+    /// window back to a single read, so streams with random skips don't read data they throw away.
+    class read_ahead_data_source : public nil::actor::data_source_impl {
+        struct pending_read {
+            uint64_t pos;
+            nil::actor::future<nil::actor::temporary_buffer<char>> block;
+        };
+
+        nil::actor::file _file;
+        read_ahead_options _options;
+        // next byte to hand out, and the end of the range the stream covers
+        uint64_t _pos;
+        uint64_t _end;
+        // start of the next block to read
+        uint64_t _next_read;
+        unsigned _window = 1;
+        unsigned _sequential = 0;
+        bool _eof = false;
+        std::deque<pending_read> _pending;
+        // reads dropped by a skip, waited for by close() before the file may be closed
+        nil::actor::future<> _dropped = nil::actor::make_ready_future<>();
+
+        uint64_t align_down(uint64_t pos) const {
+            return pos - pos % _options.buffer_size;
+        }
+
+        nil::actor::future<nil::actor::temporary_buffer<char>> read_block(uint64_t pos) {
+            // The continuations don't refer to the source, so reads dropped when the source is
+            // destroyed without being closed can complete in the background.
+            auto read = [file = _file, pos, size = _options.buffer_size, pc = _options.io_priority_class]() mutable {
+                return file.dma_read_bulk<char>(pos, size, pc);
+            };
+            auto &cache = _options.cache;
+            if (!cache) {
+                return read();
+            }
+            return cache->get_or_read(pos / _options.buffer_size, std::move(read)).finally([cache] {});
+        }
+
+        void fill_window() {
+            while (!_eof && _pending.size() < _window && _next_read < _end) {
+                _pending.push_back(pending_read {_next_read, read_block(_next_read)});
+                _next_read += _options.buffer_size;
+            }
+        }
+
+        void drop_window() {
+            for (auto &p : _pending) {
+                _dropped = std::move(_dropped).then([block = std::move(p.block)]() mutable {
+                    return std::move(block).discard_result().handle_exception([](std::exception_ptr) {});
+                });
+            }
+            _pending.clear();
+        }
+
+    public:
+        read_ahead_data_source(nil::actor::file f, uint64_t offset, uint64_t len, read_ahead_options options) :
+            _file(std::move(f)), _options(std::move(options)), _pos(offset),
+            _end(len > std::numeric_limits<uint64_t>::max() - offset ? std::numeric_limits<uint64_t>::max()
+                                                                     : offset + len),
+            _next_read(align_down(offset)) {
+            if (_options.cache && _options.cache->block_size() != _options.buffer_size) {
+                throw std::invalid_argument("block cache and stream must use the same buffer size");
+            }
+        }
+
+        ~read_ahead_data_source() {
+            drop_window();
+        }
+
+        nil::actor::future<nil::actor::temporary_buffer<char>> get() override {
+            fill_window();
+            if (_pending.empty()) {
+                return nil::actor::make_ready_future<nil::actor::temporary_buffer<char>>();
+            }
+            auto p = std::move(_pending.front());
+            _pending.pop_front();
+            return std::move(p.block).then([this, pos = p.pos](nil::actor::temporary_buffer<char> block) {
+                if (block.size() < _options.buffer_size) {
+                    // short read: the file ends within this block
+                    _eof = true;
+                    drop_window();
+                }
+                auto begin = std::min<uint64_t>(std::max(_pos, pos) - pos, block.size());
+                auto end = std::max(std::min<uint64_t>(_end - pos, block.size()), begin);
+                block.trim(end);
+                block.trim_front(begin);
+                _pos = pos + end;
+                if (++_sequential >= _window && _window < _options.max_read_ahead) {
+                    _window = std::min(_window * 2, _options.max_read_ahead);
+                    _sequential = 0;
+                }
+                return block;
+            });
+        }
+
+        nil::actor::future<nil::actor::temporary_buffer<char>> skip(uint64_t n) override {
+            drop_window();
+            _pos = std::min(_pos + n, _end);
+            _next_read = align_down(_pos);
+            _window = 1;
+            _sequential = 0;
+            return get();
+        }
+
+        nil::actor::future<> close() override {
+            drop_window();
+            return std::exchange(_dropped, nil::actor::make_ready_future<>());
+        }
+    };
+
+    /// Creates an input stream over [offset, offset + len) of the file that reads ahead as long as
+    /// it is read sequentially, optionally through a shared block cache.
+    ///
+    /// Example:
+    /// \code
+    /// #include "../lib/file_read_ahead.hh"
+    /// ...
+    /// actor_apps_lib::read_ahead_options options;
+    /// options.cache = nil::actor::make_lw_shared<actor_apps_lib::file_block_cache>(options.buffer_size, 64 << 20);
+    /// auto in = actor_apps_lib::make_read_ahead_file_input_stream(f, 0, size, options);
+    /// \endcode
+    inline nil::actor::input_stream<char> make_read_ahead_file_input_stream(
+        nil::actor::file f, uint64_t offset = 0, uint64_t len = std::numeric_limits<uint64_t>::max(),
+        read_ahead_options options = {}) {
+        return nil::actor::input_stream<char>(nil::actor::data_source(
+            std::make_unique<read_ahead_data_source>(std::move(f), offset, len, std::move(options))));
+    }
+}    // namespace actor_apps_lib
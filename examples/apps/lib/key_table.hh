@@ -0,0 +1,158 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+
+#pragma once
+
+#include <nil/actor/core/future.hh>
+#include <nil/actor/core/sharded.hh>
+#include <nil/actor/core/smp.hh>
+#include <nil/actor/core/sstring.hh>
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+/// Actor apps lib namespace
+
+namespace actor_apps_lib {
+
+    /// Fixed-size handle of an interned string key, with the hash of the string. Equal strings
+    /// interned on any shard of a key_table get equal handles.
+    struct interned_key {
+        // home shard in the top bits, index in the home shard's table below
+        uint64_t id = 0;
+        size_t hash = 0;
+
+        static constexpr unsigned index_bits = 48;
+
+        unsigned home() const noexcept {
+            return id >> index_bits;
+        }
+
+        bool operator==(const interned_key &o) const noexcept {
+            return id == o.id;
+        }
+
+        bool operator!=(const interned_key &o) const noexcept {
+            return id != o.id;
+        }
+    };
+
+    /// \brief Sharded table of interned string keys
+    ///
+    /// Actor references and messages carry their keys, so with string keys every reference is
+    /// as large as its string, and copying one to another shard copies the string. Interning
+    /// replaces the string with a 16-byte interned_key. The string is recorded on its home shard,
+    /// the one its hash maps to, which hands out the id; other shards ask it once and cache the
+    /// handle. Since interned_key hashes to the hash of its string, the default hash placement
+    /// puts an actor keyed by it on the home shard of its string, so handlers resolve their own
+    /// key back to the string without leaving the shard.
+    ///
+    /// Interned strings are kept for the life of the table.
+    ///
+    /// Example:
+    /// \code
+    /// #include "../lib/key_table.hh"
+    /// ...
+    /// nil::actor::sharded<actor_apps_lib::key_table> keys;
+    /// keys.start().get();
+    /// auto key = keys.local().intern("customer-42").get0();
+    /// nil::actor::get<customer>(key)->bill(amount);
+    /// ...
+    /// // in a handler of customer
+    /// auto &name = keys.local().local_string(key);
+    /// \endcode
+    class key_table : public nil::actor::peering_sharded_service<key_table> {
+        // strings this shard is the home of, by index
+        std::vector<nil::actor::sstring> _strings;
+        std::unordered_map<nil::actor::sstring, interned_key> _ids;
+        // handles of strings homed elsewhere
+        std::unordered_map<nil::actor::sstring, interned_key> _cache;
+
+        interned_key intern_here(const nil::actor::sstring &s, size_t hash) {
+            auto it = _ids.find(s);
+            if (it != _ids.end()) {
+                return it->second;
+            }
+            interned_key key {(uint64_t(nil::actor::this_shard_id()) << interned_key::index_bits) | _strings.size(),
+                              hash};
+            _strings.push_back(s);
+            _ids.emplace(s, key);
+            return key;
+        }
+
+    public:
+        nil::actor::future<> stop() {
+            return nil::actor::make_ready_future<>();
+        }
+
+        /// Resolves to the handle of the string, interning it if it never was.
+        nil::actor::future<interned_key> intern(const nil::actor::sstring &s) {
+            auto hash = std::hash<nil::actor::sstring> {}(s);
+            auto home = hash % nil::actor::smp::count;
+            if (home == nil::actor::this_shard_id()) {
+                return nil::actor::make_ready_future<interned_key>(intern_here(s, hash));
+            }
+            auto it = _cache.find(s);
+            if (it != _cache.end()) {
+                return nil::actor::make_ready_future<interned_key>(it->second);
+            }
+            return container()
+                .invoke_on(home, [s, hash](key_table &t) { return t.intern_here(s, hash); })
+                .then([this, s](interned_key key) {
+                    _cache.emplace(s, key);
+                    return key;
+                });
+        }
+
+        /// The string of a key whose home is this shard.
+        const nil::actor::sstring &local_string(interned_key key) const {
+            return _strings[key.id & ((uint64_t(1) << interned_key::index_bits) - 1)];
+        }
+
+        /// Resolves to the string of any key.
+        nil::actor::future<nil::actor::sstring> resolve(interned_key key) {
+            if (key.home() == nil::actor::this_shard_id()) {
+                return nil::actor::make_ready_future<nil::actor::sstring>(local_string(key));
+            }
+            return container().invoke_on(key.home(), [key](key_table &t) { return t.local_string(key); });
+        }
+
+        /// Strings this shard is the home of.
+        size_t size() const noexcept {
+            return _strings.size();
+        }
+    };
+}    // namespace actor_apps_lib
+
+namespace std {
+    template<>
+    struct hash<actor_apps_lib::interned_key> {
+        size_t operator()(const actor_apps_lib::interned_key &key) const noexcept {
+            return key.hash;
+        }
+    };
+}    // namespace std
@@ -0,0 +1,176 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/// Actor apps lib namespace
+
+namespace actor_apps_lib {
+
+    /// \brief Mergeable log-linear latency histogram
+    ///
+    /// HDR-style histogram: values below 2^sub_bucket_bits are counted exactly, larger
+    /// values land in one of 2^sub_bucket_bits linear sub-buckets of their power-of-two
+    /// range, which bounds the relative error of any reported value by 2^-sub_bucket_bits.
+    /// Unlike streaming quantile estimators, two histograms can be added together, so
+    /// every shard can record locally and the results are merged with map_reduce.
+    ///
+    /// Values are unit-less; apps record microseconds.
+    ///
+    /// Example:
+    /// \code
+    /// #include "../lib/latency_histogram.hh"
+    /// ...
+    /// actor_apps_lib::latency_histogram hist;
+    /// hist.record(latency.count());
+    /// ...
+    /// fmt::print("p99: {} usec\n", hist.quantile(0.99));
+    /// \endcode
+    class latency_histogram {
+    public:
+        static constexpr unsigned sub_bucket_bits = 5;
+        static constexpr uint64_t sub_bucket_count = uint64_t(1) << sub_bucket_bits;
+        // Anything above ~2^40 (12 days in usec) is clamped, which keeps the bucket
+        // vector bounded even when recording garbage.
+        static constexpr unsigned max_value_bits = 40;
+        static constexpr uint64_t max_trackable_value = (uint64_t(1) << max_value_bits) - 1;
+
+    private:
+        std::vector<uint64_t> _counts;
+        uint64_t _total = 0;
+        uint64_t _min = std::numeric_limits<uint64_t>::max();
+        uint64_t _max = 0;
+        double _sum = 0;
+
+        static unsigned bucket_index(uint64_t value) noexcept {
+            if (value < sub_bucket_count) {
+                return value;
+            }
+            unsigned msb = 63 - __builtin_clzll(value);
+            unsigned shift = msb - sub_bucket_bits;
+            return (shift + 1) * sub_bucket_count + ((value >> shift) - sub_bucket_count);
+        }
+
+        // Highest value that maps into the bucket, so reported quantiles never under-estimate.
+        static uint64_t bucket_upper_value(unsigned index) noexcept {
+            if (index < sub_bucket_count) {
+                return index;
+            }
+            unsigned shift = index / sub_bucket_count - 1;
+            uint64_t sub = index % sub_bucket_count + sub_bucket_count;
+            return ((sub + 1) << shift) - 1;
+        }
+
+    public:
+        void record(uint64_t value, uint64_t count = 1) {
+            value = std::min(value, max_trackable_value);
+            auto idx = bucket_index(value);
+            if (idx >= _counts.size()) {
+                _counts.resize(idx + 1);
+            }
+            _counts[idx] += count;
+            _total += count;
+            _sum += double(value) * count;
+            _min = std::min(_min, value);
+            _max = std::max(_max, value);
+        }
+
+        latency_histogram &operator+=(const latency_histogram &o) {
+            if (o._counts.size() > _counts.size()) {
+                _counts.resize(o._counts.size());
+            }
+            for (size_t i = 0; i < o._counts.size(); ++i) {
+                _counts[i] += o._counts[i];
+            }
+            _total += o._total;
+            _sum += o._sum;
+            _min = std::min(_min, o._min);
+            _max = std::max(_max, o._max);
+            return *this;
+        }
+
+        latency_histogram operator+(const latency_histogram &o) const {
+            latency_histogram res = *this;
+            res += o;
+            return res;
+        }
+
+        void reset() {
+            _counts.clear();
+            _total = 0;
+            _sum = 0;
+            _min = std::numeric_limits<uint64_t>::max();
+            _max = 0;
+        }
+
+        uint64_t count() const noexcept {
+            return _total;
+        }
+
+        uint64_t min() const noexcept {
+            return _total ? _min : 0;
+        }
+
+        uint64_t max() const noexcept {
+            return _max;
+        }
+
+        double mean() const noexcept {
+            return _total ? _sum / _total : 0;
+        }
+
+        /// Returns the smallest recorded value v such that at least q * count() values are <= v,
+        /// up to the bucket resolution.
+        uint64_t quantile(double q) const noexcept {
+            if (!_total) {
+                return 0;
+            }
+            auto wanted = std::max<uint64_t>(1, uint64_t(std::ceil(q * _total)));
+            uint64_t seen = 0;
+            for (unsigned i = 0; i < _counts.size(); ++i) {
+                seen += _counts[i];
+                if (seen >= wanted) {
+                    return std::min(bucket_upper_value(i), _max);
+                }
+            }
+            return _max;
+        }
+
+        /// Calls func(upper_value, count) for every non-empty bucket in increasing value order.
+        template<typename Func>
+        void for_each_bucket(Func &&func) const {
+            for (unsigned i = 0; i < _counts.size(); ++i) {
+                if (_counts[i]) {
+                    func(bucket_upper_value(i), _counts[i]);
+                }
+            }
+        }
+    };
+}    // namespace actor_apps_lib
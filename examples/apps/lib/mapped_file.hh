@@ -0,0 +1,189 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#pragma once
+
+#include <nil/actor/core/future.hh>
+#include <nil/actor/core/loop.hh>
+#include <nil/actor/core/posix.hh>
+#include <nil/actor/core/reactor.hh>
+#include <nil/actor/core/shared_ptr.hh>
+#include <nil/actor/core/sleep.hh>
+#include <nil/actor/core/sstring.hh>
+#include <nil/actor/core/temporary_buffer.hh>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <system_error>
+#include <vector>
+
+/// Actor apps lib namespace
+
+namespace actor_apps_lib {
+
+    /// \brief Read-only memory-mapped file for read-mostly lookups
+    ///
+    /// Touching a page that isn't in the page cache would stall the reactor on a major page fault,
+    /// so ranges are pre-faulted before they are handed out: prefault() asks the kernel to read
+    /// them in with madvise(MADV_WILLNEED) and polls mincore() from a timer until they are
+    /// resident. madvise() may itself block while it sets up the reads, so it runs on the syscall
+    /// thread like the blocking calls of file. Pages known to be resident are remembered, so lookups in
+    /// an already warm range make no system call at all and return a ready future.
+    ///
+    /// read() returns temporary_buffer views of the mapping, without copying; every view keeps the
+    /// mapping alive. The mapping is read-only: writing through get_write() of a view crashes the
+    /// process, so views may only be read, or passed to something that reads them. The mapping is
+    /// reference counted per shard, so views must not leave the shard that created them. A page
+    /// evicted after being pre-faulted is read in by a regular page fault.
+    ///
+    /// Example:
+    /// \code
+    /// #include "../lib/mapped_file.hh"
+    /// ...
+    /// auto index = actor_apps_lib::mapped_file::open("index.db");
+    /// return index.read(offset, sizeof(entry)).then([](nil::actor::temporary_buffer<char> buf) { ... });
+    /// \endcode
+    class mapped_file {
+        struct mapping {
+            char *addr = nullptr;
+            size_t size = 0;
+            // pages known to be resident
+            std::vector<bool> resident;
+
+            ~mapping() {
+                if (addr) {
+                    ::munmap(addr, size);
+                }
+            }
+        };
+
+        nil::actor::lw_shared_ptr<mapping> _map;
+
+        static size_t page_size() {
+            static const size_t size = ::sysconf(_SC_PAGESIZE);
+            return size;
+        }
+
+        std::pair<size_t, size_t> page_range(uint64_t offset, size_t len) const {
+            auto end = std::min<uint64_t>(offset + len, _map->size);
+            return {offset / page_size(), (end + page_size() - 1) / page_size()};
+        }
+
+        bool known_resident(size_t first, size_t last) const {
+            return std::all_of(_map->resident.begin() + first, _map->resident.begin() + last,
+                               [](bool r) { return r; });
+        }
+
+        // Asks the kernel which pages are resident now, and remembers them.
+        bool check_resident(size_t first, size_t last) {
+            std::vector<unsigned char> vec(last - first);
+            auto start = _map->addr + first * page_size();
+            if (::mincore(start, (last - first) * page_size(), vec.data()) != 0) {
+                throw std::system_error(errno, std::system_category(), "mincore");
+            }
+            bool all = true;
+            for (size_t i = 0; i < vec.size(); ++i) {
+                if (vec[i] & 1) {
+                    _map->resident[first + i] = true;
+                } else {
+                    all = false;
+                }
+            }
+            return all;
+        }
+
+        explicit mapped_file(nil::actor::lw_shared_ptr<mapping> map) : _map(std::move(map)) {
+        }
+
+    public:
+        /// Opens and maps the whole file. Both are blocking system calls, so call it while
+        /// starting up rather than on a latency-sensitive path.
+        static mapped_file open(nil::actor::sstring name) {
+            auto fd = nil::actor::file_desc::open(name, O_RDONLY | O_CLOEXEC);
+            auto st = fd.stat();
+            auto map = nil::actor::make_lw_shared<mapping>();
+            map->size = st.st_size;
+            if (map->size) {
+                auto addr = ::mmap(nullptr, map->size, PROT_READ, MAP_SHARED, fd.get(), 0);
+                if (addr == MAP_FAILED) {
+                    throw std::system_error(errno, std::system_category(), "mmap");
+                }
+                map->addr = static_cast<char *>(addr);
+            }
+            map->resident.resize((map->size + page_size() - 1) / page_size());
+            return mapped_file(std::move(map));
+        }
+
+        size_t size() const noexcept {
+            return _map->size;
+        }
+
+        /// Resolves once [offset, offset + len) is resident, or after timeout, whichever comes first;
+        /// in the latter case the remaining pages are left to page faults.
+        nil::actor::future<> prefault(uint64_t offset, size_t len,
+                                      std::chrono::milliseconds timeout = std::chrono::milliseconds(100)) {
+            auto range = page_range(offset, len);
+            if (range.first >= range.second || known_resident(range.first, range.second) ||
+                check_resident(range.first, range.second)) {
+                return nil::actor::make_ready_future<>();
+            }
+            auto start = _map->addr + range.first * page_size();
+            auto size = (range.second - range.first) * page_size();
+            auto deadline = std::chrono::steady_clock::now() + timeout;
+            auto delay = nil::actor::make_lw_shared<std::chrono::microseconds>(50);
+            // Copies share the mapping, so neither the advice nor the poll depend on this object
+            // staying around. The advice is only a hint: if it fails, the poll times out.
+            return nil::actor::engine()
+                ._thread_pool
+                ->submit<nil::actor::syscall_result<int>>(
+                    [start, size] { return nil::actor::wrap_syscall<int>(::madvise(start, size, MADV_WILLNEED)); })
+                .then([self = *this, range, deadline, delay](nil::actor::syscall_result<int>) mutable {
+                    return nil::actor::repeat([self, range, deadline, delay]() mutable {
+                        return nil::actor::sleep(*delay).then([self, range, deadline, delay]() mutable {
+                            if (self.check_resident(range.first, range.second) ||
+                                std::chrono::steady_clock::now() > deadline) {
+                                return nil::actor::stop_iteration::yes;
+                            }
+                            *delay = std::min(*delay * 2, std::chrono::microseconds(1000));
+                            return nil::actor::stop_iteration::no;
+                        });
+                    });
+                });
+        }
+
+        /// Returns a read-only view of [offset, offset + len), clamped to the end of the file, once
+        /// it is pre-faulted. The view keeps the mapping alive.
+        nil::actor::future<nil::actor::temporary_buffer<char>> read(uint64_t offset, size_t len) {
+            offset = std::min<uint64_t>(offset, _map->size);
+            len = std::min<uint64_t>(len, _map->size - offset);
+            return prefault(offset, len).then([map = _map, offset, len] {
+                return nil::actor::temporary_buffer<char>(map->addr + offset, len, nil::actor::make_deleter([map] {}));
+            });
+        }
+    };
+}    // namespace actor_apps_lib
@@ -0,0 +1,186 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#include <nil/actor/testing/test_case.hh>
+#include <nil/actor/core/sleep.hh>
+#include <nil/actor/core/thread.hh>
+#include <nil/actor/detail/tmp_file.hh>
+
+#include <nil/actor/actor.hpp>
+
+#include "../actor_timers.hh"
+
+using namespace nil::actor;
+using namespace std::chrono_literals;
+using actor_apps_lib::reminder_table;
+using actor_apps_lib::timing_wheel;
+
+class reminded_actor : public nil::actor::actor<reminded_actor> {
+public:
+    using KeyType = int;
+
+    nil::actor::future<> receive_reminder(nil::actor::sstring name) {
+        return make_ready_future<>();
+    }
+    ACTOR_DEFINE_ACTOR(reminded_actor, (receive_reminder));
+};
+
+static void write_text(const sstring &path, const std::string &text) {
+    auto out = make_file_output_stream(open_file_dma(path, open_flags::wo | open_flags::create).get0()).get0();
+    out.write(text.data(), text.size()).get();
+    out.flush().get();
+    out.close().get();
+}
+
+ACTOR_TEST_CASE(test_wheel_runs_callbacks_in_due_order) {
+    return async([] {
+        timing_wheel wheel;
+        std::vector<int> order;
+        auto now = timing_wheel::clock_type::now();
+        wheel.schedule(now + 60ms, [&] { order.push_back(3); });
+        wheel.schedule(now + 20ms, [&] { order.push_back(1); });
+        auto cancelled = wheel.schedule(now + 30ms, [&] { order.push_back(0); });
+        wheel.schedule(now + 40ms, [&] { order.push_back(2); });
+        BOOST_REQUIRE(wheel.cancel(cancelled));
+        BOOST_REQUIRE(!wheel.cancel(cancelled));
+        BOOST_REQUIRE_EQUAL(wheel.size(), 3);
+        sleep(200ms).get();
+        BOOST_REQUIRE(order == std::vector<int>({1, 2, 3}));
+        BOOST_REQUIRE_EQUAL(wheel.size(), 0);
+    });
+}
+
+ACTOR_TEST_CASE(test_wheel_cancel_during_expire) {
+    return async([] {
+        timing_wheel wheel;
+        std::vector<sstring> ran;
+        std::vector<bool> cancelled;
+        auto at = timing_wheel::clock_type::now() + 20ms;
+        timing_wheel::id_type a = 0;
+        timing_wheel::id_type b = 0;
+        // both are due together, so they are taken off the wheel in one go, and whichever runs
+        // first cancels the other one before it runs
+        a = wheel.schedule(at, [&] {
+            ran.push_back("a");
+            cancelled.push_back(wheel.cancel(b));
+            wheel.schedule(timing_wheel::clock_type::now(), [&] { ran.push_back("rescheduled"); });
+        });
+        b = wheel.schedule(at, [&] {
+            ran.push_back("b");
+            cancelled.push_back(wheel.cancel(a));
+            wheel.schedule(timing_wheel::clock_type::now(), [&] { ran.push_back("rescheduled"); });
+        });
+        sleep(200ms).get();
+        BOOST_REQUIRE(cancelled == std::vector<bool>({true}));
+        BOOST_REQUIRE_EQUAL(ran.size(), 2);
+        BOOST_REQUIRE_EQUAL(ran[1], "rescheduled");
+        BOOST_REQUIRE_EQUAL(wheel.size(), 0);
+    });
+}
+
+ACTOR_TEST_CASE(test_wheel_callback_cancelling_itself_is_a_no_op) {
+    return async([] {
+        timing_wheel wheel;
+        timing_wheel::id_type id = 0;
+        bool cancelled = true;
+        id = wheel.schedule(timing_wheel::clock_type::now() + 10ms, [&] { cancelled = wheel.cancel(id); });
+        sleep(100ms).get();
+        BOOST_REQUIRE(!cancelled);
+        BOOST_REQUIRE_EQUAL(wheel.size(), 0);
+    });
+}
+
+ACTOR_TEST_CASE(test_wheel_stop_cancels_everything) {
+    return async([] {
+        timing_wheel wheel;
+        bool ran = false;
+        for (int i = 0; i < 10; ++i) {
+            wheel.schedule(timing_wheel::clock_type::now() + 20ms, [&] { ran = true; });
+        }
+        wheel.stop();
+        BOOST_REQUIRE_EQUAL(wheel.size(), 0);
+        sleep(100ms).get();
+        BOOST_REQUIRE(!ran);
+    });
+}
+
+ACTOR_TEST_CASE(test_reminders_survive_a_restart) {
+    return tmp_dir::do_with_thread([](tmp_dir &t) {
+        sstring path = (t.get_path() / "reminders").native();
+        {
+            reminder_table<reminded_actor> table(path);
+            table.start().get();
+            table.register_reminder(1, "expire", 1h, 0h).get();
+            table.register_reminder(1, "flush", 1h, 1h).get();
+            table.register_reminder(2, "flush", 2h, 1h).get();
+            // replacing keeps one reminder of the name
+            table.register_reminder(2, "flush", 3h, 1h).get();
+            BOOST_REQUIRE_EQUAL(table.size(), 3);
+            table.stop().get();
+            BOOST_REQUIRE_EQUAL(table.get_stats().writes, 4);
+            BOOST_REQUIRE_EQUAL(table.get_stats().write_errors, 0);
+        }
+        {
+            reminder_table<reminded_actor> table(path);
+            table.start().get();
+            BOOST_REQUIRE_EQUAL(table.size(), 3);
+            BOOST_REQUIRE(table.unregister_reminder(1, "expire").get0());
+            BOOST_REQUIRE(!table.unregister_reminder(1, "expire").get0());
+            BOOST_REQUIRE(!table.unregister_reminder(3, "flush").get0());
+            table.stop().get();
+        }
+        {
+            reminder_table<reminded_actor> table(path);
+            table.start().get();
+            BOOST_REQUIRE_EQUAL(table.size(), 2);
+            BOOST_REQUIRE(table.unregister_reminder(1, "flush").get0());
+            BOOST_REQUIRE(table.unregister_reminder(2, "flush").get0());
+            table.stop().get();
+        }
+        {
+            reminder_table<reminded_actor> table(path);
+            table.start().get();
+            BOOST_REQUIRE_EQUAL(table.size(), 0);
+            table.stop().get();
+        }
+    });
+}
+
+ACTOR_TEST_CASE(test_reminder_table_rejects_bad_input) {
+    return tmp_dir::do_with_thread([](tmp_dir &t) {
+        sstring path = (t.get_path() / "reminders").native();
+        {
+            reminder_table<reminded_actor> table(path);
+            table.start().get();
+            BOOST_REQUIRE_THROW(table.register_reminder(1, "two words", 1h, 0h).get(), std::invalid_argument);
+            BOOST_REQUIRE_THROW(table.register_reminder(1, "", 1h, 0h).get(), std::invalid_argument);
+            BOOST_REQUIRE_EQUAL(table.size(), 0);
+            table.stop().get();
+        }
+        write_text(path, "expire 1700000000000 0\n");
+        reminder_table<reminded_actor> table(path);
+        BOOST_REQUIRE_THROW(table.start().get(), std::runtime_error);
+        table.stop().get();
+    });
+}
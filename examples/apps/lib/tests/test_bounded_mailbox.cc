@@ -0,0 +1,192 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#include <nil/actor/testing/test_case.hh>
+#include <nil/actor/core/semaphore.hh>
+#include <nil/actor/core/sleep.hh>
+#include <nil/actor/core/thread.hh>
+#include <nil/actor/core/when_all.hh>
+#include <nil/actor/core/with_timeout.hh>
+
+#include "../bounded_mailbox.hh"
+
+using namespace nil::actor;
+using namespace std::chrono_literals;
+using actor_apps_lib::bounded_mailbox;
+using actor_apps_lib::overflow_policy;
+
+// A message that runs until release() is called.
+struct blocker {
+    lw_shared_ptr<promise<>> released = make_lw_shared<promise<>>();
+    lw_shared_ptr<bool> started = make_lw_shared<bool>(false);
+
+    std::function<future<>()> message() const {
+        return [released = released, started = started] {
+            *started = true;
+            return released->get_future();
+        };
+    }
+
+    void release() {
+        released->set_value();
+    }
+};
+
+template<typename... T>
+static future<T...> within_timeout(future<T...> f) {
+    return with_timeout(lowres_clock::now() + 5s, std::move(f));
+}
+
+ACTOR_TEST_CASE(test_messages_run_alone_in_post_order) {
+    return async([] {
+        bounded_mailbox mailbox(16);
+        std::vector<int> order;
+        unsigned running = 0;
+        unsigned max_running = 0;
+        std::vector<future<>> posted;
+        for (int i = 0; i < 10; ++i) {
+            posted.push_back(mailbox.post([&, i] {
+                max_running = std::max(max_running, ++running);
+                return sleep(1ms).then([&, i] {
+                    order.push_back(i);
+                    running--;
+                });
+            }));
+        }
+        when_all_succeed(posted.begin(), posted.end()).get();
+        BOOST_REQUIRE_EQUAL(max_running, 1);
+        BOOST_REQUIRE(order == std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+        BOOST_REQUIRE_EQUAL(mailbox.get_stats().posted, 10);
+        mailbox.close().get();
+    });
+}
+
+ACTOR_TEST_CASE(test_consecutive_shared_messages_run_together) {
+    return async([] {
+        bounded_mailbox mailbox(16);
+        blocker writer, first, second;
+        bool last_ran = false;
+        auto w = mailbox.post(writer.message());
+        auto r1 = mailbox.post_shared(first.message());
+        auto r2 = mailbox.post_shared(second.message());
+        auto last = mailbox.post([&] { last_ran = true; });
+        BOOST_REQUIRE(!*first.started);
+        writer.release();
+        w.get();
+        // second completes while first is still running, so they run together
+        second.release();
+        within_timeout(std::move(r2)).get();
+        BOOST_REQUIRE(*first.started);
+        BOOST_REQUIRE(!last_ran);
+        first.release();
+        r1.get();
+        last.get();
+        BOOST_REQUIRE(last_ran);
+        mailbox.close().get();
+    });
+}
+
+ACTOR_TEST_CASE(test_results_and_exceptions_reach_the_sender) {
+    return async([] {
+        bounded_mailbox mailbox(4);
+        BOOST_REQUIRE_EQUAL(mailbox.post([] { return 42; }).get0(), 42);
+        BOOST_REQUIRE_THROW(mailbox.post([] { throw std::runtime_error("oops"); }).get(), std::runtime_error);
+        // a failed message doesn't stop the ones after it
+        BOOST_REQUIRE_EQUAL(mailbox.post([] { return make_ready_future<int>(7); }).get0(), 7);
+        mailbox.close().get();
+    });
+}
+
+ACTOR_TEST_CASE(test_fail_policy_rejects_the_new_message) {
+    return async([] {
+        bounded_mailbox mailbox(1, overflow_policy::fail);
+        blocker running;
+        auto a = mailbox.post(running.message());
+        auto b = mailbox.post([] {});
+        BOOST_REQUIRE_THROW(mailbox.post([] {}).get(), actor_apps_lib::mailbox_full);
+        running.release();
+        a.get();
+        b.get();
+        BOOST_REQUIRE_EQUAL(mailbox.get_stats().rejected, 1);
+        mailbox.close().get();
+    });
+}
+
+ACTOR_TEST_CASE(test_drop_oldest_policy_drops_the_oldest_waiting_message) {
+    return async([] {
+        bounded_mailbox mailbox(1, overflow_policy::drop_oldest);
+        blocker running;
+        bool newest_ran = false;
+        auto a = mailbox.post(running.message());
+        auto b = mailbox.post([] {});
+        auto c = mailbox.post([&] { newest_ran = true; });
+        BOOST_REQUIRE_THROW(b.get(), actor_apps_lib::message_dropped);
+        running.release();
+        a.get();
+        c.get();
+        BOOST_REQUIRE(newest_ran);
+        BOOST_REQUIRE_EQUAL(mailbox.get_stats().dropped, 1);
+        mailbox.close().get();
+    });
+}
+
+ACTOR_TEST_CASE(test_waiting_post_is_not_stranded_when_the_mailbox_drains) {
+    return async([] {
+        bounded_mailbox mailbox(1, overflow_policy::wait);
+        for (int round = 0; round < 100; ++round) {
+            blocker running;
+            auto a = mailbox.post(running.message());
+            // b takes the only place; c waits and gets the place b frees when it starts, while
+            // b completes right away and leaves the mailbox empty
+            auto b = mailbox.post([] {});
+            auto c = mailbox.post([] {});
+            running.release();
+            a.get();
+            b.get();
+            within_timeout(std::move(c)).get();
+        }
+        BOOST_REQUIRE_EQUAL(mailbox.get_stats().waited, 100);
+        BOOST_REQUIRE_EQUAL(mailbox.depth(), 0);
+        mailbox.close().get();
+    });
+}
+
+ACTOR_TEST_CASE(test_close_fails_waiting_and_new_posts) {
+    return async([] {
+        bounded_mailbox mailbox(1, overflow_policy::wait);
+        blocker running;
+        bool queued_ran = false;
+        auto a = mailbox.post(running.message());
+        auto b = mailbox.post([&] { queued_ran = true; });
+        auto c = mailbox.post([] {});
+        auto closed = mailbox.close();
+        BOOST_REQUIRE_THROW(c.get(), broken_semaphore);
+        BOOST_REQUIRE_THROW(mailbox.post([] {}).get(), gate_closed_exception);
+        running.release();
+        a.get();
+        b.get();
+        closed.get();
+        BOOST_REQUIRE(queued_ran);
+    });
+}
@@ -0,0 +1,151 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#include <nil/actor/testing/test_case.hh>
+#include <nil/actor/core/file.hh>
+#include <nil/actor/core/io_intent.hh>
+#include <nil/actor/core/temporary_buffer.hh>
+#include <nil/actor/core/thread.hh>
+#include <nil/actor/detail/tmp_file.hh>
+
+#include "../coalescing_file.hh"
+
+#include <cstring>
+
+using namespace nil::actor;
+using actor_apps_lib::coalescing_file;
+
+constexpr size_t block = 4096;
+
+static temporary_buffer<char> make_pattern(size_t blocks) {
+    auto buf = temporary_buffer<char>::aligned(block, blocks * block);
+    for (size_t i = 0; i < blocks; ++i) {
+        std::memset(buf.get_write() + i * block, char(i % 251), block);
+    }
+    return buf;
+}
+
+static file open_data_file(tmp_dir &t) {
+    return open_file_dma((t.get_path() / "data").native(), open_flags::rw | open_flags::create).get0();
+}
+
+ACTOR_TEST_CASE(test_writes_merge_in_groups_of_at_most_max_iov) {
+    return tmp_dir::do_with_thread([](tmp_dir &t) {
+        auto f = open_data_file(t);
+        // the first write takes the only slot, the others queue behind it
+        const size_t pieces = coalescing_file::max_iov + 500;
+        auto data = make_pattern(pieces + 1);
+        coalescing_file cf(f, 1, (pieces + 1) * block);
+        std::vector<future<size_t>> writes;
+        for (size_t i = 0; i <= pieces; ++i) {
+            writes.push_back(cf.dma_write(i * block, data.get() + i * block, block));
+        }
+        for (auto &w : writes) {
+            BOOST_REQUIRE_EQUAL(w.get0(), block);
+        }
+        BOOST_REQUIRE_EQUAL(cf.write_stats().requests, pieces + 1);
+        BOOST_REQUIRE_EQUAL(cf.write_stats().ios, 3);
+        BOOST_REQUIRE_EQUAL(cf.write_stats().merged(), pieces - 2);
+
+        auto back = temporary_buffer<char>::aligned(block, data.size());
+        BOOST_REQUIRE_EQUAL(f.dma_read(0, back.get_write(), back.size()).get0(), back.size());
+        BOOST_REQUIRE(std::memcmp(back.get(), data.get(), data.size()) == 0);
+        f.close().get();
+    });
+}
+
+ACTOR_TEST_CASE(test_merged_reads_are_split_back) {
+    return tmp_dir::do_with_thread([](tmp_dir &t) {
+        auto f = open_data_file(t);
+        auto data = make_pattern(8);
+        f.dma_write(0, data.get(), data.size()).get();
+
+        coalescing_file cf(f, 1);
+        std::vector<temporary_buffer<char>> bufs;
+        std::vector<future<size_t>> reads;
+        // one read alone, then adjacent ones out of order and two overlapping ones
+        std::vector<std::pair<uint64_t, size_t>> ranges = {{0, 1}, {3, 1}, {1, 2}, {4, 2}, {5, 3}};
+        for (auto &r : ranges) {
+            bufs.push_back(temporary_buffer<char>::aligned(block, r.second * block));
+            reads.push_back(cf.dma_read(r.first * block, bufs.back().get_write(), bufs.back().size()));
+        }
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            BOOST_REQUIRE_EQUAL(reads[i].get0(), bufs[i].size());
+            BOOST_REQUIRE(std::memcmp(bufs[i].get(), data.get() + ranges[i].first * block, bufs[i].size()) == 0);
+        }
+        BOOST_REQUIRE_EQUAL(cf.read_stats().requests, ranges.size());
+        BOOST_REQUIRE_EQUAL(cf.read_stats().ios, 2);
+        f.close().get();
+    });
+}
+
+ACTOR_TEST_CASE(test_merges_respect_direction_intent_and_size) {
+    return tmp_dir::do_with_thread([](tmp_dir &t) {
+        auto f = open_data_file(t);
+        auto data = make_pattern(4);
+        f.dma_write(0, data.get(), data.size()).get();
+
+        coalescing_file cf(f, 1, 2 * block);
+        io_intent intent;
+        auto buf = temporary_buffer<char>::aligned(block, 5 * block);
+        auto first = cf.dma_read(0, buf.get_write(), block);
+        // all adjacent or overlapping, but a write, a read with another intent, and two reads too
+        // large to merge
+        auto write = cf.dma_write(block, data.get() + block, block);
+        auto other = cf.dma_read(block, buf.get_write() + block, block, &intent);
+        auto small = cf.dma_read(block, buf.get_write() + 4 * block, block);
+        auto big = cf.dma_read(2 * block, buf.get_write() + 2 * block, 2 * block);
+        BOOST_REQUIRE_EQUAL(first.get0(), block);
+        BOOST_REQUIRE_EQUAL(write.get0(), block);
+        BOOST_REQUIRE_EQUAL(other.get0(), block);
+        BOOST_REQUIRE_EQUAL(small.get0(), block);
+        BOOST_REQUIRE_EQUAL(big.get0(), 2 * block);
+        BOOST_REQUIRE_EQUAL(cf.read_stats().merged(), 0);
+        BOOST_REQUIRE_EQUAL(cf.write_stats().merged(), 0);
+        f.close().get();
+    });
+}
+
+ACTOR_TEST_CASE(test_cancel_fails_queued_requests_of_the_intent) {
+    return tmp_dir::do_with_thread([](tmp_dir &t) {
+        auto f = open_data_file(t);
+        auto data = make_pattern(3);
+        f.dma_write(0, data.get(), data.size()).get();
+
+        coalescing_file cf(f, 1);
+        io_intent intent;
+        auto buf = temporary_buffer<char>::aligned(block, 3 * block);
+        auto first = cf.dma_read(0, buf.get_write(), block, nullptr, 1);
+        auto cancelled = cf.dma_read(block, buf.get_write() + block, block, &intent, 2);
+        auto kept = cf.dma_read(2 * block, buf.get_write() + 2 * block, block, nullptr, 1);
+        BOOST_REQUIRE_EQUAL(cf.cancel(intent), block);
+        BOOST_REQUIRE_THROW(cancelled.get(), cancelled_error);
+        BOOST_REQUIRE_EQUAL(first.get0(), block);
+        BOOST_REQUIRE_EQUAL(kept.get0(), block);
+        BOOST_REQUIRE_EQUAL(cf.read_stats().cancelled, 1);
+        BOOST_REQUIRE_EQUAL(cf.tag_stats(2).cancelled_bytes, block);
+        BOOST_REQUIRE_EQUAL(cf.tag_stats(1).requests, 2);
+        f.close().get();
+    });
+}
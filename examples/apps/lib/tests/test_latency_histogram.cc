@@ -0,0 +1,119 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#include <nil/actor/testing/test_case.hh>
+#include <nil/actor/core/future.hh>
+
+#include "../latency_histogram.hh"
+
+using namespace nil::actor;
+using actor_apps_lib::latency_histogram;
+
+ACTOR_TEST_CASE(test_empty_histogram_reports_zeros) {
+    latency_histogram h;
+    BOOST_REQUIRE_EQUAL(h.count(), 0);
+    BOOST_REQUIRE_EQUAL(h.min(), 0);
+    BOOST_REQUIRE_EQUAL(h.max(), 0);
+    BOOST_REQUIRE_EQUAL(h.mean(), 0);
+    BOOST_REQUIRE_EQUAL(h.quantile(0.99), 0);
+    return make_ready_future<>();
+}
+
+ACTOR_TEST_CASE(test_small_values_are_exact) {
+    latency_histogram h;
+    for (uint64_t v = 1; v <= 10; ++v) {
+        h.record(v);
+    }
+    BOOST_REQUIRE_EQUAL(h.count(), 10);
+    BOOST_REQUIRE_EQUAL(h.min(), 1);
+    BOOST_REQUIRE_EQUAL(h.max(), 10);
+    BOOST_REQUIRE_EQUAL(h.mean(), 5.5);
+    BOOST_REQUIRE_EQUAL(h.quantile(0.5), 5);
+    BOOST_REQUIRE_EQUAL(h.quantile(0.9), 9);
+    BOOST_REQUIRE_EQUAL(h.quantile(1.0), 10);
+    return make_ready_future<>();
+}
+
+ACTOR_TEST_CASE(test_quantiles_stay_within_bucket_resolution) {
+    latency_histogram h;
+    for (uint64_t v = 1; v <= 100000; ++v) {
+        h.record(v);
+    }
+    for (double q : {0.5, 0.9, 0.99, 0.999}) {
+        auto exact = uint64_t(q * 100000);
+        auto reported = h.quantile(q);
+        // quantiles are rounded up to the end of their bucket, never down
+        BOOST_REQUIRE_GE(reported, exact);
+        BOOST_REQUIRE_LE(reported - exact, exact >> latency_histogram::sub_bucket_bits);
+    }
+    BOOST_REQUIRE_EQUAL(h.quantile(1.0), 100000);
+    return make_ready_future<>();
+}
+
+ACTOR_TEST_CASE(test_huge_values_are_clamped) {
+    latency_histogram h;
+    h.record(std::numeric_limits<uint64_t>::max());
+    BOOST_REQUIRE_EQUAL(h.max(), latency_histogram::max_trackable_value);
+    BOOST_REQUIRE_EQUAL(h.quantile(0.5), latency_histogram::max_trackable_value);
+    return make_ready_future<>();
+}
+
+ACTOR_TEST_CASE(test_merge_matches_recording_everything_in_one) {
+    latency_histogram a, b, all;
+    for (uint64_t v = 0; v < 5000; ++v) {
+        a.record(v * 3);
+        all.record(v * 3);
+    }
+    for (uint64_t v = 0; v < 1000; ++v) {
+        b.record(v * 1000 + 7, 2);
+        all.record(v * 1000 + 7, 2);
+    }
+    auto merged = a + b;
+    BOOST_REQUIRE_EQUAL(merged.count(), all.count());
+    BOOST_REQUIRE_EQUAL(merged.min(), all.min());
+    BOOST_REQUIRE_EQUAL(merged.max(), all.max());
+    BOOST_REQUIRE_EQUAL(merged.mean(), all.mean());
+    for (double q : {0.1, 0.5, 0.9, 0.99, 0.999, 1.0}) {
+        BOOST_REQUIRE_EQUAL(merged.quantile(q), all.quantile(q));
+    }
+    std::vector<std::pair<uint64_t, uint64_t>> merged_buckets, all_buckets;
+    merged.for_each_bucket([&](uint64_t v, uint64_t c) { merged_buckets.emplace_back(v, c); });
+    all.for_each_bucket([&](uint64_t v, uint64_t c) { all_buckets.emplace_back(v, c); });
+    BOOST_REQUIRE(merged_buckets == all_buckets);
+    return make_ready_future<>();
+}
+
+ACTOR_TEST_CASE(test_merge_with_empty_keeps_min) {
+    latency_histogram h, empty;
+    h.record(42);
+    h += empty;
+    BOOST_REQUIRE_EQUAL(h.min(), 42);
+    empty += h;
+    BOOST_REQUIRE_EQUAL(empty.min(), 42);
+    BOOST_REQUIRE_EQUAL(empty.quantile(0.5), 42);
+    h.reset();
+    BOOST_REQUIRE_EQUAL(h.count(), 0);
+    BOOST_REQUIRE_EQUAL(h.min(), 0);
+    return make_ready_future<>();
+}
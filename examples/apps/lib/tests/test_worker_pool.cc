@@ -0,0 +1,124 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#include <nil/actor/testing/test_case.hh>
+#include <nil/actor/core/gate.hh>
+#include <nil/actor/core/shared_future.hh>
+#include <nil/actor/core/sleep.hh>
+#include <nil/actor/core/thread.hh>
+#include <nil/actor/core/with_timeout.hh>
+
+#include "../worker_pool.hh"
+
+using namespace nil::actor;
+using namespace std::chrono_literals;
+using actor_apps_lib::worker_pool;
+using actor_apps_lib::worker_pool_options;
+
+struct worker {
+    unsigned calls = 0;
+};
+
+static worker_pool_options one_to_four_workers() {
+    worker_pool_options options;
+    options.min_workers = 1;
+    options.max_workers = 4;
+    options.max_queue_delay = 1ms;
+    options.idle_timeout = 10s;
+    return options;
+}
+
+ACTOR_TEST_CASE(test_calls_reuse_an_idle_worker) {
+    return async([] {
+        worker_pool<worker> pool(one_to_four_workers());
+        for (unsigned i = 1; i <= 10; ++i) {
+            BOOST_REQUIRE_EQUAL(pool.submit([](worker &w) { return ++w.calls; }).get0(), i);
+        }
+        BOOST_REQUIRE_EQUAL(pool.size(), 1);
+        BOOST_REQUIRE_EQUAL(pool.get_stats().calls, 10);
+        BOOST_REQUIRE_EQUAL(pool.get_stats().queued_calls, 0);
+        pool.stop().get();
+    });
+}
+
+ACTOR_TEST_CASE(test_pool_grows_while_every_worker_is_stuck) {
+    return async([] {
+        worker_pool<worker> pool(one_to_four_workers());
+        promise<> release;
+        auto stuck = pool.submit([&release](worker &) { return release.get_future(); });
+        // no call has completed yet, so only the periodic check sees this one waiting
+        auto queued = pool.submit([](worker &) {});
+        BOOST_REQUIRE_EQUAL(pool.queue_length(), 1);
+        with_timeout(lowres_clock::now() + 5s, std::move(queued)).get();
+        BOOST_REQUIRE_EQUAL(pool.size(), 2);
+        BOOST_REQUIRE_EQUAL(pool.get_stats().queued_calls, 1);
+        release.set_value();
+        stuck.get();
+        pool.stop().get();
+    });
+}
+
+ACTOR_TEST_CASE(test_pool_does_not_grow_beyond_max_workers) {
+    return async([] {
+        auto options = one_to_four_workers();
+        options.max_workers = 2;
+        worker_pool<worker> pool(options);
+        promise<> release;
+        shared_future<> released(release.get_future());
+        std::vector<future<>> calls;
+        for (int i = 0; i < 5; ++i) {
+            calls.push_back(pool.submit([released](worker &) { return released.get_future(); }));
+        }
+        sleep(10ms).get();
+        BOOST_REQUIRE_EQUAL(pool.size(), 2);
+        BOOST_REQUIRE_EQUAL(pool.queue_length(), 3);
+        release.set_value();
+        for (auto &c : calls) {
+            c.get();
+        }
+        BOOST_REQUIRE_EQUAL(pool.get_stats().peak_workers, 2);
+        pool.stop().get();
+    });
+}
+
+ACTOR_TEST_CASE(test_stop_waits_for_running_calls_and_fails_the_rest) {
+    return async([] {
+        auto options = one_to_four_workers();
+        options.max_workers = 1;
+        worker_pool<worker> pool(options);
+        promise<> release;
+        bool running_done = false;
+        auto running = pool.submit([&](worker &) { return release.get_future().then([&] { running_done = true; }); });
+        auto queued = pool.submit([](worker &) {});
+        auto stopped = pool.stop();
+        BOOST_REQUIRE_THROW(queued.get(), gate_closed_exception);
+        BOOST_REQUIRE_THROW(pool.submit([](worker &) {}).get(), gate_closed_exception);
+        BOOST_REQUIRE(!stopped.available());
+        release.set_value();
+        running.get();
+        stopped.get();
+        BOOST_REQUIRE(running_done);
+        BOOST_REQUIRE_EQUAL(pool.queue_length(), 0);
+    });
+}
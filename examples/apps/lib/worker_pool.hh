@@ -0,0 +1,264 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+
+#pragma once
+
+#include <nil/actor/core/future.hh>
+#include <nil/actor/core/gate.hh>
+#include <nil/actor/core/shared_ptr.hh>
+#include <nil/actor/core/timer.hh>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+#include "latency_histogram.hh"
+
+/// Actor apps lib namespace
+
+namespace actor_apps_lib {
+
+    struct worker_pool_options {
+        /// Workers kept even when idle.
+        unsigned min_workers = 1;
+        unsigned max_workers = 16;
+        /// A worker is added when a queued call is expected to wait longer than this.
+        std::chrono::microseconds max_queue_delay = std::chrono::milliseconds(1);
+        /// Workers above min_workers idle for this long are removed.
+        std::chrono::milliseconds idle_timeout = std::chrono::seconds(1);
+    };
+
+    /// \brief Shard-local pool of stateless workers sized by load
+    ///
+    /// Like local_actor<T, N>, every worker handles one call at a time, but the number of
+    /// workers changes at run time instead of being fixed at compile time. A call goes to an idle
+    /// worker, the most recently used one, so surplus workers stay idle and are removed after
+    /// idle_timeout. When none is idle the call is queued, and a worker is added if the queue is
+    /// expected to hold it longer than max_queue_delay: the queue length times the average
+    /// handler latency, divided by the number of workers. While calls are queued, that is
+    /// checked again every max_queue_delay, so a pool whose workers are all stuck in long calls
+    /// still grows.
+    ///
+    /// Example:
+    /// \code
+    /// #include "../lib/worker_pool.hh"
+    /// ...
+    /// actor_apps_lib::worker_pool_options options;
+    /// options.max_workers = 32;
+    /// actor_apps_lib::worker_pool<resizer> pool(options);
+    /// ...
+    /// return pool.submit([image](resizer &r) { return r.resize(image); });
+    /// \endcode
+    template<typename Worker>
+    class worker_pool {
+    public:
+        using factory = std::function<std::unique_ptr<Worker>()>;
+
+        struct stats {
+            uint64_t calls = 0;
+            uint64_t queued_calls = 0;
+            uint64_t workers_added = 0;
+            uint64_t workers_removed = 0;
+            unsigned peak_workers = 0;
+            /// Time calls spent queued, in microseconds.
+            latency_histogram queue_delays;
+        };
+
+    private:
+        using clock_type = std::chrono::steady_clock;
+
+        struct slot {
+            std::unique_ptr<Worker> worker;
+            bool busy = false;
+            clock_type::time_point idle_since = clock_type::now();
+        };
+
+        struct task {
+            std::function<nil::actor::future<>(Worker &)> run;
+            // fails the call without running it
+            std::function<void(std::exception_ptr)> fail;
+            clock_type::time_point queued = clock_type::now();
+        };
+
+        worker_pool_options _options;
+        factory _factory;
+        std::vector<std::unique_ptr<slot>> _slots;
+        std::deque<task> _queue;
+        // moving average of the handler latency, unknown until a call completes
+        std::optional<std::chrono::duration<double, std::micro>> _latency;
+        stats _stats;
+        nil::actor::timer<> _shrink;
+        nil::actor::timer<> _grow;
+        nil::actor::gate _running;
+
+        slot *idle_slot() {
+            slot *best = nullptr;
+            for (auto &s : _slots) {
+                if (!s->busy && (!best || s->idle_since > best->idle_since)) {
+                    best = s.get();
+                }
+            }
+            return best;
+        }
+
+        bool should_grow() const {
+            if (_slots.size() >= _options.max_workers) {
+                return false;
+            }
+            if (_slots.size() < _options.min_workers) {
+                return true;
+            }
+            auto latency = _latency.value_or(std::chrono::duration<double, std::micro>(0));
+            auto expected = latency * double(_queue.size()) / double(_slots.size());
+            auto waited = clock_type::now() - _queue.front().queued;
+            return expected > _options.max_queue_delay || waited > _options.max_queue_delay;
+        }
+
+        slot *grow() {
+            _slots.push_back(std::make_unique<slot>(slot {_factory()}));
+            _stats.workers_added++;
+            _stats.peak_workers = std::max<unsigned>(_stats.peak_workers, _slots.size());
+            return _slots.back().get();
+        }
+
+        void shrink() {
+            auto now = clock_type::now();
+            auto it = _slots.begin();
+            while (it != _slots.end() && _slots.size() > _options.min_workers) {
+                auto &s = **it;
+                if (!s.busy && now - s.idle_since > _options.idle_timeout) {
+                    it = _slots.erase(it);
+                    _stats.workers_removed++;
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        void run(slot &s, task t) {
+            auto start = clock_type::now();
+            _stats.queue_delays.record(
+                std::chrono::duration_cast<std::chrono::microseconds>(start - t.queued).count());
+            s.busy = true;
+            (void)nil::actor::with_gate(_running, [&s, t = std::move(t)] { return t.run(*s.worker); })
+                .finally([this, &s, start] {
+                    auto now = clock_type::now();
+                    auto latency = std::chrono::duration<double, std::micro>(now - start);
+                    _latency = _latency ? *_latency * 0.9 + latency * 0.1 : latency;
+                    s.busy = false;
+                    s.idle_since = now;
+                    dispatch();
+                });
+        }
+
+        void dispatch() {
+            while (!_queue.empty() && !_running.is_closed()) {
+                auto s = idle_slot();
+                if (!s) {
+                    if (!should_grow()) {
+                        break;
+                    }
+                    s = grow();
+                }
+                auto t = std::move(_queue.front());
+                _queue.pop_front();
+                run(*s, std::move(t));
+            }
+            if (_queue.empty()) {
+                _grow.cancel();
+            } else if (!_grow.armed()) {
+                _grow.arm_periodic(std::max(_options.max_queue_delay, std::chrono::microseconds(100)));
+            }
+        }
+
+    public:
+        explicit worker_pool(worker_pool_options options = {},
+                             factory f = [] { return std::make_unique<Worker>(); }) :
+            _options(options),
+            _factory(std::move(f)), _shrink([this] { shrink(); }), _grow([this] { dispatch(); }) {
+            while (_slots.size() < _options.min_workers) {
+                grow();
+            }
+            _shrink.arm_periodic(std::max(_options.idle_timeout / 2, std::chrono::milliseconds(1)));
+        }
+
+        worker_pool(const worker_pool &) = delete;
+
+        /// Calls func with a worker once one is free; func may return a future. func must be
+        /// copyable.
+        template<typename Func>
+        auto submit(Func func) {
+            using futurator = nil::actor::futurize<std::invoke_result_t<Func &, Worker &>>;
+            auto pr = nil::actor::make_lw_shared<typename futurator::promise_type>();
+            auto f = pr->get_future();
+            if (_running.is_closed()) {
+                pr->set_exception(nil::actor::gate_closed_exception());
+                return f;
+            }
+            _stats.calls++;
+            if (!idle_slot()) {
+                _stats.queued_calls++;
+            }
+            task t;
+            t.run = [pr, func = std::move(func)](Worker &w) mutable {
+                return futurator::invoke(func, w).then_wrapped([pr](auto f) { f.forward_to(std::move(*pr)); });
+            };
+            t.fail = [pr](std::exception_ptr ex) { pr->set_exception(std::move(ex)); };
+            _queue.push_back(std::move(t));
+            dispatch();
+            return f;
+        }
+
+        /// Waits for the running calls. Queued calls, and calls submitted from now on, fail with
+        /// gate_closed_exception.
+        nil::actor::future<> stop() {
+            _shrink.cancel();
+            _grow.cancel();
+            auto closed = _running.close();
+            for (auto &t : _queue) {
+                t.fail(std::make_exception_ptr(nil::actor::gate_closed_exception()));
+            }
+            _queue.clear();
+            return closed;
+        }
+
+        unsigned size() const noexcept {
+            return _slots.size();
+        }
+
+        size_t queue_length() const noexcept {
+            return _queue.size();
+        }
+
+        const stats &get_stats() const noexcept {
+            return _stats;
+        }
+    };
+}    // namespace actor_apps_lib
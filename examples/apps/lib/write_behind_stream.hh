@@ -0,0 +1,218 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+#pragma once
+
+#include <nil/actor/core/file.hh>
+#include <nil/actor/core/gate.hh>
+#include <nil/actor/core/iostream.hh>
+#include <nil/actor/core/loop.hh>
+#include <nil/actor/core/reactor.hh>
+#include <nil/actor/core/semaphore.hh>
+#include <nil/actor/core/temporary_buffer.hh>
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+
+/// Actor apps lib namespace
+
+namespace actor_apps_lib {
+
+    struct write_behind_options {
+        /// Size of every write; a multiple of the file's DMA alignment.
+        size_t buffer_size = 128 << 10;
+        /// Writes in flight at most; put() only waits once that many are pending.
+        unsigned write_behind = 4;
+        /// Size hint for open_write_behind_file(), so the file system allocates large extents
+        /// up front instead of growing the file write by write.
+        uint64_t preallocation_size = 32 << 20;
+        nil::actor::io_priority_class io_priority_class = nil::actor::default_priority_class();
+    };
+
+    /// \brief File data sink keeping several sequential writes in flight
+    ///
+    /// Data is gathered into aligned buffers of buffer_size, and every full buffer is written in
+    /// the background while the caller keeps producing the next one, up to write_behind writes.
+    /// A failed write fails the next put(), flush() or close().
+    ///
+    /// flush() waits for the writes in flight and flushes the file, but keeps a trailing partial
+    /// buffer in memory: DMA can only write whole aligned blocks. close() writes it padded with
+    /// zeroes and truncates the file back to the number of bytes written, so the file never ends
+    /// with padding or preallocated space.
+    class write_behind_data_sink : public nil::actor::data_sink_impl {
+        nil::actor::file _file;
+        write_behind_options _options;
+        size_t _alignment;
+        nil::actor::temporary_buffer<char> _buf;
+        size_t _buf_used = 0;
+        // file position of _buf
+        uint64_t _pos = 0;
+        nil::actor::semaphore _slots;
+        nil::actor::gate _writes;
+        std::exception_ptr _error;
+
+        nil::actor::temporary_buffer<char> new_buffer() {
+            return nil::actor::temporary_buffer<char>::aligned(_alignment, _options.buffer_size);
+        }
+
+        nil::actor::future<> check_error() {
+            if (_error) {
+                return nil::actor::make_exception_future<>(_error);
+            }
+            return nil::actor::make_ready_future<>();
+        }
+
+        // Writes out the first len bytes of the current buffer in the background.
+        nil::actor::future<> write_buffer(size_t len) {
+            auto buf = std::exchange(_buf, new_buffer());
+            auto pos = _pos;
+            _pos += len;
+            _buf_used = 0;
+            // the write is always queued before an earlier error is reported, so close() finds it
+            // in the gate
+            return nil::actor::get_units(_slots, 1).then(
+                [this, buf = std::move(buf), pos, len](auto units) mutable {
+                    (void)nil::actor::with_gate(_writes, [this, buf = std::move(buf), pos, len,
+                                                          units = std::move(units)]() mutable {
+                        auto data = buf.get();
+                        return _file.dma_write(pos, data, len, _options.io_priority_class)
+                            .then([len](size_t written) {
+                                if (written != len) {
+                                    throw std::runtime_error("short write");
+                                }
+                            })
+                            .handle_exception([this](std::exception_ptr ep) { _error = ep; })
+                            .finally([buf = std::move(buf), units = std::move(units)] {});
+                    });
+                    return check_error();
+                });
+        }
+
+        // Waits for all writes in flight, keeping the sink usable.
+        nil::actor::future<> drain() {
+            return nil::actor::get_units(_slots, _options.write_behind).then([this](auto units) {
+                return check_error();
+            });
+        }
+
+    public:
+        write_behind_data_sink(nil::actor::file f, write_behind_options options) :
+            _file(std::move(f)), _options(std::move(options)), _alignment(_file.disk_write_dma_alignment()),
+            _buf(new_buffer()), _slots(std::max(_options.write_behind, 1u)) {
+            _options.write_behind = std::max(_options.write_behind, 1u);
+        }
+
+        nil::actor::future<> put(nil::actor::net::packet data) override {
+            return nil::actor::do_with(std::move(data), [this](nil::actor::net::packet &p) {
+                return nil::actor::do_for_each(p.fragments(), [this](nil::actor::net::fragment f) {
+                    return put(nil::actor::temporary_buffer<char>(f.base, f.size, nil::actor::deleter()));
+                });
+            });
+        }
+
+        nil::actor::future<> put(std::vector<nil::actor::temporary_buffer<char>> data) override {
+            return nil::actor::do_with(std::move(data), [this](auto &bufs) {
+                return nil::actor::do_for_each(bufs, [this](auto &buf) { return put(std::move(buf)); });
+            });
+        }
+
+        nil::actor::future<> put(nil::actor::temporary_buffer<char> data) override {
+            if (_error) {
+                return check_error();
+            }
+            return nil::actor::do_with(std::move(data), [this](nil::actor::temporary_buffer<char> &data) {
+                return nil::actor::repeat([this, &data] {
+                    if (data.empty()) {
+                        return nil::actor::make_ready_future<nil::actor::stop_iteration>(
+                            nil::actor::stop_iteration::yes);
+                    }
+                    auto n = std::min(data.size(), _options.buffer_size - _buf_used);
+                    std::memcpy(_buf.get_write() + _buf_used, data.get(), n);
+                    _buf_used += n;
+                    data.trim_front(n);
+                    if (_buf_used < _options.buffer_size) {
+                        return nil::actor::make_ready_future<nil::actor::stop_iteration>(
+                            nil::actor::stop_iteration::yes);
+                    }
+                    return write_buffer(_options.buffer_size).then([] { return nil::actor::stop_iteration::no; });
+                });
+            });
+        }
+
+        nil::actor::future<> flush() override {
+            return drain().then([this] { return _file.flush(); });
+        }
+
+        nil::actor::future<> close() override {
+            auto size = _pos + _buf_used;
+            auto tail = nil::actor::make_ready_future<>();
+            if (_buf_used && !_error) {
+                auto padded = (_buf_used + _alignment - 1) / _alignment * _alignment;
+                std::memset(_buf.get_write() + _buf_used, 0, padded - _buf_used);
+                tail = write_buffer(padded);
+            }
+            // wait for every write in flight even if one failed, they refer to the sink and the file
+            return tail
+                .then_wrapped([this](nil::actor::future<> f) {
+                    f.ignore_ready_future();
+                    return _writes.close();
+                })
+                .then([this] { return check_error(); })
+                .then([this, size] { return _file.truncate(size); })
+                .then([this] { return _file.flush(); })
+                .finally([this] { return _file.close(); });
+        }
+    };
+
+    /// Opens a file for a write-behind stream, hinting the file system to allocate extents of
+    /// options.preallocation_size.
+    inline nil::actor::future<nil::actor::file> open_write_behind_file(nil::actor::sstring name,
+                                                                      const write_behind_options &options = {}) {
+        nil::actor::file_open_options open_options;
+        open_options.extent_allocation_size_hint = options.preallocation_size;
+        return nil::actor::open_file_dma(name, nil::actor::open_flags::wo | nil::actor::open_flags::create |
+                                                   nil::actor::open_flags::truncate,
+                                         std::move(open_options));
+    }
+
+    /// Creates an output stream appending to the file from position 0 with write-behind.
+    ///
+    /// Example:
+    /// \code
+    /// #include "../lib/write_behind_stream.hh"
+    /// ...
+    /// return actor_apps_lib::open_write_behind_file("log").then([](nil::actor::file f) {
+    ///     auto out = actor_apps_lib::make_write_behind_output_stream(std::move(f));
+    ///     ...
+    /// });
+    /// \endcode
+    inline nil::actor::output_stream<char> make_write_behind_output_stream(nil::actor::file f,
+                                                                           write_behind_options options = {}) {
+        auto buffer_size = options.buffer_size;
+        return nil::actor::output_stream<char>(
+            nil::actor::data_sink(std::make_unique<write_behind_data_sink>(std::move(f), std::move(options))),
+            buffer_size);
+    }
+}    // namespace actor_apps_lib
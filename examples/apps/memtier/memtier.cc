@@ -0,0 +1,646 @@
+//---------------------------------------------------------------------------//
+// Copyright (c) 2018-2021 Mikhail Komarov <nemo@nil.foundation>
+//
+// MIT License
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------//
+
+
+// Load generator for apps/memcached, in the spirit of memaslap/memtier_benchmark.
+//
+// Every shard opens its share of the connections, so one box can saturate a
+// multi-core server. Each connection keeps `pipeline` requests in flight; over
+// UDP requests use the same 8-byte frame header as memcache::udp_server.
+
+#include <nil/actor/network/api.hh>
+#include <nil/actor/core/core.hh>
+#include <nil/actor/core/print.hh>
+#include <nil/actor/core/app-template.hh>
+#include <nil/actor/core/distributed.hh>
+#include <nil/actor/core/loop.hh>
+#include <nil/actor/core/semaphore.hh>
+#include <nil/actor/core/with_timeout.hh>
+#include <nil/actor/core/timer.hh>
+#include <nil/actor/detail/log.hh>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <optional>
+#include <random>
+#include <unordered_map>
+#include <boost/range/irange.hpp>
+
+#include "../lib/latency_histogram.hh"
+
+using namespace nil::actor;
+using namespace net;
+
+static thread_local std::default_random_engine random_generator(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(steady_clock_type::now().time_since_epoch()).count());
+
+std::array<double, 4> quantiles = {0.5, 0.95, 0.99, 0.999};
+
+enum class op_type { get, set };
+enum class key_distribution { uniform, zipf };
+enum class transport { tcp, udp };
+
+struct workload_config {
+    transport proto = transport::tcp;
+    unsigned duration = 10;
+    unsigned reqs_per_conn = 0;
+    unsigned pipeline = 1;
+    uint64_t key_count = 100000;
+    std::string key_prefix = "key:";
+    key_distribution distribution = key_distribution::uniform;
+    double zipf_exponent = 0.99;
+    unsigned set_ratio = 1;
+    unsigned get_ratio = 10;
+    size_t value_min = 32;
+    size_t value_max = 32;
+    std::chrono::milliseconds udp_timeout {100};
+};
+
+// Rejection-inversion sampling of a Zipf distribution over [1, n] (W. Hormann,
+// G. Derflinger, "Rejection-inversion to generate variates from monotone discrete
+// distributions"). Constant memory and constant expected time, so it works for key
+// spaces of any size without precomputing a CDF.
+class zipf_distribution {
+    uint64_t _n;
+    double _exponent;
+    double _h_integral_x1;
+    double _h_integral_n;
+    double _s;
+
+    static double helper1(double x) {
+        return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+    }
+
+    static double helper2(double x) {
+        return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1 + x * 0.5 * (1 + x * (1.0 / 3) * (1 + 0.25 * x));
+    }
+
+    double h(double x) const {
+        return std::exp(-_exponent * std::log(x));
+    }
+
+    double h_integral(double x) const {
+        auto log_x = std::log(x);
+        return helper2((1 - _exponent) * log_x) * log_x;
+    }
+
+    double h_integral_inverse(double x) const {
+        auto t = std::max(x * (1 - _exponent), -1.0);
+        return std::exp(helper1(t) * x);
+    }
+
+public:
+    zipf_distribution(uint64_t n, double exponent) :
+        _n(n), _exponent(exponent), _h_integral_x1(h_integral(1.5) - 1), _h_integral_n(h_integral(n + 0.5)),
+        _s(2 - h_integral_inverse(h_integral(2.5) - h(2))) {
+    }
+
+    template<typename Engine>
+    uint64_t operator()(Engine &engine) {
+        std::uniform_real_distribution<double> uniform(0, 1);
+        while (true) {
+            auto u = _h_integral_n + uniform(engine) * (_h_integral_x1 - _h_integral_n);
+            auto x = h_integral_inverse(u);
+            auto k = std::clamp<double>(std::floor(x + 0.5), 1, _n);
+            if (k - x <= _s || u >= h_integral(k + 0.5) - h(k)) {
+                return uint64_t(k);
+            }
+        }
+    }
+};
+
+class key_generator {
+    std::optional<zipf_distribution> _zipf;
+    std::uniform_int_distribution<uint64_t> _uniform;
+
+public:
+    explicit key_generator(const workload_config &cfg) : _uniform(0, cfg.key_count - 1) {
+        if (cfg.distribution == key_distribution::zipf) {
+            _zipf.emplace(cfg.key_count, cfg.zipf_exponent);
+        }
+    }
+
+    // Rank 0 is the most popular key under zipf.
+    uint64_t next() {
+        return _zipf ? (*_zipf)(random_generator) - 1 : _uniform(random_generator);
+    }
+};
+
+// Incremental parser for the responses of the ascii protocol. Responses are
+// self-delimiting, so a pipelined batch of gets and sets can be parsed in order
+// without knowing which command produced them.
+class response_parser {
+public:
+    enum class result { stored, hit, miss, error };
+
+private:
+    std::string _line;
+    size_t _value_left = 0;
+    bool _got_value = false;
+    unsigned _pending = 0;
+    bool _eof = false;
+    std::vector<std::pair<result, steady_clock_type::time_point>> _results;
+
+    void complete(result r) {
+        _results.emplace_back(r, steady_clock_type::now());
+        _pending--;
+        _got_value = false;
+    }
+
+    void handle_line() {
+        if (_line.compare(0, 6, "VALUE ") == 0) {
+            auto sp = _line.rfind(' ');
+            // data block followed by \r\n
+            _value_left = std::stoul(_line.substr(sp + 1)) + 2;
+            _got_value = true;
+        } else if (_line == "END") {
+            complete(_got_value ? result::hit : result::miss);
+        } else if (_line == "STORED") {
+            complete(result::stored);
+        } else {
+            // NOT_STORED, ERROR, CLIENT_ERROR, SERVER_ERROR
+            complete(result::error);
+        }
+    }
+
+public:
+    void init(unsigned expected) {
+        _line.clear();
+        _value_left = 0;
+        _got_value = false;
+        _pending = expected;
+        _results.clear();
+    }
+
+    bool done() const {
+        return !_pending;
+    }
+
+    bool eof() const {
+        return _eof;
+    }
+
+    const std::vector<std::pair<result, steady_clock_type::time_point>> &results() const {
+        return _results;
+    }
+
+    // Returns the first byte not consumed, which is `end` unless all expected responses are complete.
+    const char *feed(const char *p, const char *end) {
+        while (p != end && _pending) {
+            if (_value_left) {
+                auto n = std::min<size_t>(_value_left, end - p);
+                p += n;
+                _value_left -= n;
+                continue;
+            }
+            auto nl = std::find(p, end, '\n');
+            _line.append(p, nl);
+            if (nl == end) {
+                return end;
+            }
+            p = nl + 1;
+            if (!_line.empty() && _line.back() == '\r') {
+                _line.pop_back();
+            }
+            handle_line();
+            _line.clear();
+        }
+        return p;
+    }
+
+    // for input_stream::consume():
+    using unconsumed_remainder = std::optional<temporary_buffer<char>>;
+    future<unconsumed_remainder> operator()(temporary_buffer<char> data) {
+        if (data.empty()) {
+            _eof = true;
+            return make_ready_future<unconsumed_remainder>(std::move(data));
+        }
+        auto p = feed(data.begin(), data.end());
+        if (done()) {
+            data.trim_front(p - data.begin());
+            return make_ready_future<unconsumed_remainder>(std::move(data));
+        }
+        return make_ready_future<unconsumed_remainder>();
+    }
+};
+
+struct op_stats {
+    uint64_t ops = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t errors = 0;
+    uint64_t timeouts = 0;
+    actor_apps_lib::latency_histogram latencies;
+
+    op_stats &operator+=(const op_stats &o) {
+        ops += o.ops;
+        hits += o.hits;
+        misses += o.misses;
+        errors += o.errors;
+        timeouts += o.timeouts;
+        latencies += o.latencies;
+        return *this;
+    }
+};
+
+using client_stats = std::array<op_stats, 2>;
+
+class memtier_client {
+    workload_config _cfg;
+    unsigned _conn_per_core;
+    socket_address _server;
+    key_generator _keys;
+    std::bernoulli_distribution _is_set;
+    std::uniform_int_distribution<size_t> _value_size;
+    std::string _value;
+    client_stats _stats;
+    timer<> _run_timer;
+    bool _timer_done = false;
+    semaphore _conn_finished {0};
+
+public:
+    class tcp_connection {
+        memtier_client &_client;
+        connected_socket _fd;
+        input_stream<char> _in;
+        output_stream<char> _out;
+        response_parser _parser;
+        std::vector<op_type> _batch;
+        uint64_t _nr_done = 0;
+
+    public:
+        tcp_connection(memtier_client &client, connected_socket &&fd) :
+            _client(client), _fd(std::move(fd)), _in(_fd.input()), _out(_fd.output()) {
+        }
+
+        future<> run() {
+            return do_until([this] { return _client.done(_nr_done); }, [this] { return do_batch(); })
+                .finally([this] { return _out.close(); });
+        }
+
+    private:
+        future<> do_batch() {
+            std::string req;
+            _batch.clear();
+            for (unsigned i = 0; i < _client._cfg.pipeline; ++i) {
+                _batch.push_back(_client.append_request(req));
+            }
+            auto start = steady_clock_type::now();
+            return do_with(std::move(req), [this, start](std::string &req) {
+                return _out.write(req.data(), req.size())
+                    .then([this] { return _out.flush(); })
+                    .then([this, start] {
+                        _parser.init(_batch.size());
+                        return _in.consume(_parser).then([this, start] {
+                            if (_parser.eof() && !_parser.done()) {
+                                throw std::runtime_error("connection closed by server");
+                            }
+                            auto &results = _parser.results();
+                            for (unsigned i = 0; i < results.size(); ++i) {
+                                _client.add_result(_batch[i], results[i].first, results[i].second - start);
+                            }
+                            _nr_done += results.size();
+                        });
+                    });
+            });
+        }
+    };
+
+    class udp_connection {
+        struct header {
+            uint16_t _request_id;
+            uint16_t _sequence_number;
+            uint16_t _n;
+            uint16_t _reserved;
+        } __attribute__((packed));
+
+        struct pending_request {
+            uint16_t n = 0;
+            std::map<uint16_t, std::string> parts;
+            promise<response_parser::result> done;
+        };
+
+        memtier_client &_client;
+        udp_channel _chan;
+        uint16_t _next_request_id = 0;
+        std::unordered_map<uint16_t, pending_request> _pending;
+        std::optional<future<>> _receiver;
+        uint64_t _nr_done = 0;
+
+        void handle_datagram(udp_datagram dgram) {
+            packet &p = dgram.get_data();
+            auto hdr_ptr = p.len() >= sizeof(header) ? p.get_header<header>() : nullptr;
+            if (!hdr_ptr) {
+                return;
+            }
+            auto request_id = ntohs(hdr_ptr->_request_id);
+            auto seq = ntohs(hdr_ptr->_sequence_number);
+            auto n = ntohs(hdr_ptr->_n);
+            auto it = _pending.find(request_id);
+            if (it == _pending.end()) {
+                // late reply to a request that already timed out
+                return;
+            }
+            p.trim_front(sizeof(header));
+            auto &req = it->second;
+            auto &part = req.parts[seq];
+            for (auto &frag : p.fragments()) {
+                part.append(frag.base, frag.size);
+            }
+            req.n = n;
+            if (req.parts.size() < req.n) {
+                return;
+            }
+            response_parser parser;
+            parser.init(1);
+            for (auto &pt : req.parts) {
+                parser.feed(pt.second.data(), pt.second.data() + pt.second.size());
+            }
+            req.done.set_value(parser.done() ? parser.results().front().first : response_parser::result::error);
+            _pending.erase(it);
+        }
+
+        future<> do_request() {
+            std::string dgram(sizeof(header), '\0');
+            auto request_id = _next_request_id++;
+            auto hdr = reinterpret_cast<header *>(dgram.data());
+            hdr->_request_id = htons(request_id);
+            hdr->_sequence_number = htons(0);
+            hdr->_n = htons(1);
+            auto op = _client.append_request(dgram);
+            auto fut = _pending[request_id].done.get_future();
+            auto start = steady_clock_type::now();
+            return _chan.send(_client._server, packet(dgram.data(), dgram.size()))
+                .then([this, op, start, request_id, fut = std::move(fut)]() mutable {
+                    return with_timeout(steady_clock_type::now() + _client._cfg.udp_timeout, std::move(fut))
+                        .then([this, op, start](response_parser::result r) {
+                            _client.add_result(op, r, steady_clock_type::now() - start);
+                        })
+                        .handle_exception_type([this, op, request_id](timed_out_error &) {
+                            _pending.erase(request_id);
+                            _client.add_timeout(op);
+                        });
+                })
+                .then([this] { _nr_done++; });
+        }
+
+    public:
+        explicit udp_connection(memtier_client &client) : _client(client), _chan(make_udp_channel()) {
+            // Run in the background until the channel is shut down.
+            _receiver = keep_doing([this] {
+                return _chan.receive().then([this](udp_datagram dgram) { handle_datagram(std::move(dgram)); });
+            });
+        }
+
+        future<> run() {
+            return parallel_for_each(boost::irange(0u, _client._cfg.pipeline),
+                                     [this](unsigned) {
+                                         return do_until([this] { return _client.done(_nr_done); },
+                                                         [this] { return do_request(); });
+                                     })
+                .finally([this] {
+                    _chan.shutdown_input();
+                    _chan.shutdown_output();
+                    return _receiver->handle_exception([](std::exception_ptr) {});
+                });
+        }
+    };
+
+    memtier_client(workload_config cfg, unsigned total_conn, ipv4_addr server) :
+        _cfg(std::move(cfg)), _conn_per_core(total_conn / smp::count), _server(make_ipv4_address(server)),
+        _keys(_cfg), _is_set(double(_cfg.set_ratio) / (_cfg.set_ratio + _cfg.get_ratio)),
+        _value_size(_cfg.value_min, _cfg.value_max), _value(_cfg.value_max, 'x'),
+        _run_timer([this] { _timer_done = true; }) {
+    }
+
+    bool done(uint64_t nr_done) const {
+        if (_cfg.reqs_per_conn == 0) {
+            return _timer_done;
+        } else {
+            return nr_done >= _cfg.reqs_per_conn;
+        }
+    }
+
+    op_type append_request(std::string &out) {
+        auto op = _is_set(random_generator) ? op_type::set : op_type::get;
+        auto key = _cfg.key_prefix + std::to_string(_keys.next());
+        if (op == op_type::get) {
+            out += "get ";
+            out += key;
+            out += "\r\n";
+        } else {
+            auto size = _value_size(random_generator);
+            out += fmt::format("set {} 0 0 {}\r\n", key, size);
+            out.append(_value.data(), size);
+            out += "\r\n";
+        }
+        return op;
+    }
+
+    void add_result(op_type op, response_parser::result r, steady_clock_type::duration latency) {
+        auto &st = _stats[static_cast<unsigned>(op)];
+        st.ops++;
+        switch (r) {
+            case response_parser::result::hit:
+                st.hits++;
+                break;
+            case response_parser::result::miss:
+                st.misses++;
+                break;
+            case response_parser::result::error:
+                st.errors++;
+                break;
+            case response_parser::result::stored:
+                break;
+        }
+        st.latencies.record(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+    }
+
+    void add_timeout(op_type op) {
+        _stats[static_cast<unsigned>(op)].timeouts++;
+    }
+
+    client_stats stats() const {
+        return _stats;
+    }
+
+    future<> run() {
+        if (_cfg.reqs_per_conn == 0) {
+            _run_timer.arm(std::chrono::seconds(_cfg.duration));
+        }
+        for (unsigned i = 0; i < _conn_per_core; i++) {
+            // Run in the background, signal _conn_finished when done.
+            (void)run_connection()
+                .handle_exception([](std::exception_ptr e) { fmt::print("memcached request error: {}\n", e); })
+                .finally([this] { _conn_finished.signal(); });
+        }
+        return _conn_finished.wait(_conn_per_core);
+    }
+
+    future<> stop() {
+        return make_ready_future<>();
+    }
+
+private:
+    future<> run_connection() {
+        if (_cfg.proto == transport::udp) {
+            auto conn = std::make_unique<udp_connection>(*this);
+            auto &c = *conn;
+            return c.run().finally([conn = std::move(conn)] {});
+        }
+        return nil::actor::connect(_server).then([this](connected_socket fd) {
+            auto conn = std::make_unique<tcp_connection>(*this, std::move(fd));
+            auto &c = *conn;
+            return c.run().finally([conn = std::move(conn)] {});
+        });
+    }
+};
+
+void print_op_stats(const char *name, const op_stats &st, double secs) {
+    fmt::print("{}\n", name);
+    fmt::print("  Ops                : {:>8}\n", st.ops);
+    fmt::print("  Ops/sec            : {:>8.0f}\n", st.ops / secs);
+    if (st.hits + st.misses) {
+        fmt::print("  Hit ratio          : {:>8.2f}%\n", st.hits * 100.0 / (st.hits + st.misses));
+    }
+    fmt::print("  Errors             : {:>8}\n", st.errors);
+    fmt::print("  Timeouts           : {:>8}\n", st.timeouts);
+    fmt::print("  Lat average        : {:>8.0f} usec\n", st.latencies.mean());
+    for (auto &q : quantiles) {
+        fmt::print("  Lat quantile={:>5} : {:>8} usec\n", q, st.latencies.quantile(q));
+    }
+    fmt::print("  Lat max            : {:>8} usec\n", st.latencies.max());
+}
+
+namespace bpo = boost::program_options;
+
+int main(int ac, char **av) {
+    app_template::config app_cfg;
+    app_cfg.auto_handle_sigint_sigterm = false;
+    app_template app(std::move(app_cfg));
+
+    app.add_options()("server,s", bpo::value<std::string>()->default_value("127.0.0.1:11211"), "Server address")(
+        "protocol", bpo::value<std::string>()->default_value("tcp"), "tcp | udp")(
+        "conn,c", bpo::value<unsigned>()->default_value(100), "total connections")(
+        "reqs,r", bpo::value<unsigned>()->default_value(0), "reqs per connection (0: run for --duration)")(
+        "duration,d", bpo::value<unsigned>()->default_value(10), "duration of the test in seconds")(
+        "pipeline", bpo::value<unsigned>()->default_value(1), "requests in flight per connection")(
+        "keys", bpo::value<uint64_t>()->default_value(100000), "size of the key space")(
+        "key-prefix", bpo::value<std::string>()->default_value("key:"), "prefix of generated keys")(
+        "key-distribution", bpo::value<std::string>()->default_value("uniform"), "uniform | zipf")(
+        "zipf-exponent", bpo::value<double>()->default_value(0.99), "skew of the zipf key distribution")(
+        "ratio", bpo::value<std::string>()->default_value("1:10"), "set:get ratio")(
+        "value-size", bpo::value<std::string>()->default_value("32"), "value size in bytes, or MIN-MAX")(
+        "udp-timeout", bpo::value<unsigned>()->default_value(100), "UDP reply timeout in milliseconds");
+
+    return app.run(ac, av, [&app]() -> future<int> {
+        auto &config = app.configuration();
+        auto server = config["server"].as<std::string>();
+        auto total_conn = config["conn"].as<unsigned>();
+
+        if (total_conn % smp::count != 0) {
+            fmt::print("Error: conn needs to be n * cpu_nr\n");
+            return make_ready_future<int>(-1);
+        }
+
+        workload_config cfg;
+        try {
+            auto proto = config["protocol"].as<std::string>();
+            if (proto != "tcp" && proto != "udp") {
+                throw std::invalid_argument(format("unknown protocol {}", proto));
+            }
+            cfg.proto = proto == "udp" ? transport::udp : transport::tcp;
+            cfg.duration = config["duration"].as<unsigned>();
+            cfg.reqs_per_conn = config["reqs"].as<unsigned>();
+            cfg.pipeline = std::max(config["pipeline"].as<unsigned>(), 1u);
+            cfg.key_count = std::max<uint64_t>(config["keys"].as<uint64_t>(), 1);
+            cfg.key_prefix = config["key-prefix"].as<std::string>();
+            auto dist = config["key-distribution"].as<std::string>();
+            if (dist != "uniform" && dist != "zipf") {
+                throw std::invalid_argument(format("unknown key distribution {}", dist));
+            }
+            cfg.distribution = dist == "zipf" ? key_distribution::zipf : key_distribution::uniform;
+            cfg.zipf_exponent = config["zipf-exponent"].as<double>();
+            auto ratio = config["ratio"].as<std::string>();
+            auto colon = ratio.find(':');
+            if (colon == std::string::npos) {
+                throw std::invalid_argument(format("ratio {} is not in SET:GET form", ratio));
+            }
+            cfg.set_ratio = std::stoul(ratio.substr(0, colon));
+            cfg.get_ratio = std::stoul(ratio.substr(colon + 1));
+            if (cfg.set_ratio + cfg.get_ratio == 0) {
+                throw std::invalid_argument("ratio must not be 0:0");
+            }
+            auto value_size = config["value-size"].as<std::string>();
+            auto dash = value_size.find('-');
+            cfg.value_min = std::stoul(value_size.substr(0, dash));
+            cfg.value_max = dash == std::string::npos ? cfg.value_min : std::stoul(value_size.substr(dash + 1));
+            if (cfg.value_min > cfg.value_max) {
+                throw std::invalid_argument(format("empty value size range {}", value_size));
+            }
+            cfg.udp_timeout = std::chrono::milliseconds(config["udp-timeout"].as<unsigned>());
+        } catch (std::exception &ex) {
+            fmt::print("Error: {}\n", ex.what());
+            return make_ready_future<int>(-1);
+        }
+
+        auto clients = new distributed<memtier_client>;
+
+        auto started = steady_clock_type::now();
+        fmt::print("========== memtier ============\n");
+        fmt::print("Server: {} ({})\n", server, config["protocol"].as<std::string>());
+        fmt::print("Connections: {:d}, pipeline {:d}\n", total_conn, cfg.pipeline);
+        fmt::print("Keys: {:d} ({})\n", cfg.key_count, config["key-distribution"].as<std::string>());
+        fmt::print("Set:Get ratio: {:d}:{:d}\n", cfg.set_ratio, cfg.get_ratio);
+        return clients->start(cfg, total_conn, ipv4_addr {server})
+            .then([clients] { return clients->invoke_on_all(&memtier_client::run); })
+            .then([clients] {
+                return clients->map_reduce0([](memtier_client &c) { return c.stats(); }, client_stats(),
+                                            [](client_stats res, const client_stats &shard) {
+                                                res[0] += shard[0];
+                                                res[1] += shard[1];
+                                                return res;
+                                            });
+            })
+            .then([clients, started](client_stats stats) {
+                auto secs = std::chrono::duration<double>(steady_clock_type::now() - started).count();
+                auto &gets = stats[static_cast<unsigned>(op_type::get)];
+                auto &sets = stats[static_cast<unsigned>(op_type::set)];
+                fmt::print("Total cpus: {:d}\n", smp::count);
+                fmt::print("Total ops: {:d}\n", gets.ops + sets.ops);
+                fmt::print("Total time: {:f}\n", secs);
+                fmt::print("Ops/sec: {:f}\n", (gets.ops + sets.ops) / secs);
+                print_op_stats("GET", gets, secs);
+                print_op_stats("SET", sets, secs);
+                fmt::print("==========     done     ============\n");
+                return clients->stop().then([clients] {
+                    delete clients;
+                    return make_ready_future<int>(0);
+                });
+            });
+    });
+}
@@ -30,6 +30,13 @@
 #include <nil/actor/core/distributed.hh>
 #include <nil/actor/core/semaphore.hh>
 #include <chrono>
+#include <random>
+#include <strings.h>
+#include <boost/lexical_cast.hpp>
+#include <yaml-cpp/yaml.h>
+
+#include "../lib/byte_size.hh"
+#include "../lib/latency_histogram.hh"
 
 using namespace nil::actor;
 
@@ -40,6 +47,137 @@ void http_debug(const char *fmt, Args &&...args) {
 #endif
 }
 
+static thread_local std::default_random_engine random_generator(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(steady_clock_type::now().time_since_epoch()).count());
+
+std::array<double, 4> quantiles = {0.5, 0.95, 0.99, 0.999};
+
+using actor_apps_lib::byte_size;
+
+// URL with randomized parts. Placeholders are substituted on every request:
+//
+// {int:LO-HI} : uniformly distributed integer in [LO, HI]
+// {hex:N}     : N random hexadecimal digits
+class url_pattern {
+    struct segment {
+        enum class kind { literal, integer, hex };
+        kind type;
+        std::string text;
+        uint64_t lo = 0;
+        uint64_t hi = 0;
+    };
+
+    std::string _pattern;
+    std::vector<segment> _segments;
+
+    static segment parse_placeholder(const std::string &spec) {
+        auto colon = spec.find(':');
+        if (colon == std::string::npos) {
+            throw std::invalid_argument(format("invalid URL placeholder {{{}}}", spec));
+        }
+        auto type = spec.substr(0, colon);
+        auto arg = spec.substr(colon + 1);
+        segment seg;
+        if (type == "int") {
+            auto dash = arg.find('-');
+            if (dash == std::string::npos) {
+                throw std::invalid_argument(format("URL placeholder {{{}}} needs a LO-HI range", spec));
+            }
+            seg.type = segment::kind::integer;
+            seg.lo = boost::lexical_cast<uint64_t>(arg.substr(0, dash));
+            seg.hi = boost::lexical_cast<uint64_t>(arg.substr(dash + 1));
+            if (seg.lo > seg.hi) {
+                throw std::invalid_argument(format("URL placeholder {{{}}} has an empty range", spec));
+            }
+        } else if (type == "hex") {
+            seg.type = segment::kind::hex;
+            seg.hi = boost::lexical_cast<uint64_t>(arg);
+        } else {
+            throw std::invalid_argument(format("unknown URL placeholder type {{{}}}", spec));
+        }
+        return seg;
+    }
+
+public:
+    url_pattern() : url_pattern("/") {
+    }
+
+    explicit url_pattern(std::string pattern) : _pattern(std::move(pattern)) {
+        size_t pos = 0;
+        while (pos < _pattern.size()) {
+            auto open = _pattern.find('{', pos);
+            if (open != pos) {
+                auto len = (open == std::string::npos ? _pattern.size() : open) - pos;
+                _segments.push_back(segment {segment::kind::literal, _pattern.substr(pos, len)});
+                pos += len;
+                continue;
+            }
+            auto close = _pattern.find('}', open);
+            if (close == std::string::npos) {
+                throw std::invalid_argument(format("unterminated placeholder in URL {}", _pattern));
+            }
+            _segments.push_back(parse_placeholder(_pattern.substr(open + 1, close - open - 1)));
+            pos = close + 1;
+        }
+    }
+
+    const std::string &pattern() const {
+        return _pattern;
+    }
+
+    std::string generate() const {
+        static const char hex_digits[] = "0123456789abcdef";
+        std::string url;
+        for (auto &seg : _segments) {
+            switch (seg.type) {
+                case segment::kind::literal:
+                    url += seg.text;
+                    break;
+                case segment::kind::integer:
+                    url += std::to_string(std::uniform_int_distribution<uint64_t>(seg.lo, seg.hi)(random_generator));
+                    break;
+                case segment::kind::hex: {
+                    std::uniform_int_distribution<unsigned> digit(0, 15);
+                    for (uint64_t i = 0; i < seg.hi; ++i) {
+                        url += hex_digits[digit(random_generator)];
+                    }
+                    break;
+                }
+            }
+        }
+        return url;
+    }
+};
+
+// One entry of the workload file. Each request picks a template at random,
+// proportionally to its weight.
+struct request_template {
+    std::string name = "default";
+    unsigned weight = 1;
+    std::string method = "GET";
+    url_pattern url;
+    std::vector<std::pair<std::string, std::string>> headers;
+    uint64_t body_size = 0;
+
+    bool has_header(const std::string &name) const {
+        return std::any_of(headers.begin(), headers.end(),
+                           [&name](auto &h) { return strcasecmp(h.first.c_str(), name.c_str()) == 0; });
+    }
+};
+
+struct template_stats {
+    uint64_t requests = 0;
+    uint64_t bytes = 0;
+    actor_apps_lib::latency_histogram latencies;
+
+    template_stats &operator+=(const template_stats &o) {
+        requests += o.requests;
+        bytes += o.bytes;
+        latencies += o.latencies;
+        return *this;
+    }
+};
+
 class http_client {
 private:
     unsigned _duration;
@@ -53,10 +191,38 @@ private:
     bool _timer_done {false};
     uint64_t _total_reqs {0};
 
+    std::vector<request_template> _templates;
+    // Everything after the request line is fixed per template, so render it once.
+    std::vector<sstring> _fixed_headers;
+    std::vector<sstring> _bodies;
+    std::vector<template_stats> _stats;
+    std::discrete_distribution<unsigned> _template_distribution;
+
 public:
-    http_client(unsigned duration, unsigned total_conn, unsigned reqs_per_conn) :
-        _duration(duration), _conn_per_core(total_conn / smp::count), _reqs_per_conn(reqs_per_conn),
-        _run_timer([this] { _timer_done = true; }), _timer_based(reqs_per_conn == 0) {
+    http_client(unsigned duration, unsigned total_conn, unsigned reqs_per_conn, std::vector<request_template> templates,
+                sstring host) :
+        _duration(duration),
+        _conn_per_core(total_conn / smp::count), _reqs_per_conn(reqs_per_conn),
+        _run_timer([this] { _timer_done = true; }), _timer_based(reqs_per_conn == 0), _templates(std::move(templates)),
+        _stats(_templates.size()) {
+        std::vector<unsigned> weights;
+        for (auto &t : _templates) {
+            sstring hdr;
+            if (!t.has_header("Host")) {
+                hdr += format("Host: {}\r\n", host);
+            }
+            for (auto &h : t.headers) {
+                hdr += format("{}: {}\r\n", h.first, h.second);
+            }
+            if (t.body_size) {
+                hdr += format("Content-Length: {:d}\r\n", t.body_size);
+            }
+            hdr += "\r\n";
+            _fixed_headers.push_back(std::move(hdr));
+            _bodies.push_back(sstring(t.body_size, 'x'));
+            weights.push_back(t.weight);
+        }
+        _template_distribution = std::discrete_distribution<unsigned>(weights.begin(), weights.end());
     }
 
     class connection {
@@ -78,11 +244,13 @@ public:
         }
 
         future<> do_req() {
-            return _write_buf.write("GET / HTTP/1.1\r\nHost: 127.0.0.1:10000\r\n\r\n")
+            auto idx = _http_client->pick_template();
+            auto start = steady_clock_type::now();
+            return _http_client->write_request(idx, _write_buf)
                 .then([this] { return _write_buf.flush(); })
-                .then([this] {
+                .then([this, idx, start] {
                     _parser.init();
-                    return _read_buf.consume(_parser).then([this] {
+                    return _read_buf.consume(_parser).then([this, idx, start] {
                         // Read HTTP response header first
                         if (_parser.eof()) {
                             return make_ready_future<>();
@@ -96,25 +264,55 @@ public:
                         auto content_len = std::stoi(it->second);
                         http_debug("Content-Length = %d\n", content_len);
                         // Read HTTP response body
-                        return _read_buf.read_exactly(content_len).then([this](temporary_buffer<char> buf) {
-                            _nr_done++;
-                            http_debug("%s\n", buf.get());
-                            if (_http_client->done(_nr_done)) {
-                                return make_ready_future();
-                            } else {
-                                return do_req();
-                            }
-                        });
+                        return _read_buf.read_exactly(content_len)
+                            .then([this, idx, start](temporary_buffer<char> buf) {
+                                _nr_done++;
+                                _http_client->add_result(idx, buf.size(), steady_clock_type::now() - start);
+                                http_debug("%s\n", buf.get());
+                                if (_http_client->done(_nr_done)) {
+                                    return make_ready_future();
+                                } else {
+                                    return do_req();
+                                }
+                            });
                     });
                 });
         }
     };
 
+    unsigned pick_template() {
+        return _template_distribution(random_generator);
+    }
+
+    future<> write_request(unsigned idx, output_stream<char> &out) {
+        auto &t = _templates[idx];
+        auto head = format("{} {} HTTP/1.1\r\n{}", t.method, t.url.generate(), _fixed_headers[idx]);
+        return do_with(std::move(head), [this, idx, &out](sstring &head) {
+            return out.write(head).then([this, idx, &out] {
+                if (_bodies[idx].empty()) {
+                    return make_ready_future<>();
+                }
+                return out.write(_bodies[idx]);
+            });
+        });
+    }
+
+    void add_result(unsigned idx, size_t bytes, steady_clock_type::duration latency) {
+        auto &st = _stats[idx];
+        st.requests++;
+        st.bytes += bytes;
+        st.latencies.record(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+    }
+
     future<uint64_t> total_reqs() {
         fmt::print("Requests on cpu {:2d}: {:d}\n", this_shard_id(), _total_reqs);
         return make_ready_future<uint64_t>(_total_reqs);
     }
 
+    std::vector<template_stats> stats() const {
+        return _stats;
+    }
+
     bool done(uint64_t nr_done) {
         if (_timer_based) {
             return _timer_done;
@@ -170,6 +368,64 @@ public:
     }
 };
 
+/// YAML parsing functions
+namespace YAML {
+    template<>
+    struct convert<request_template> {
+        static bool decode(const Node &node, request_template &rt) {
+            rt.name = node["name"].as<std::string>();
+            if (node["weight"]) {
+                rt.weight = node["weight"].as<unsigned>();
+            }
+            if (node["method"]) {
+                rt.method = node["method"].as<std::string>();
+            }
+            if (node["url"]) {
+                rt.url = url_pattern(node["url"].as<std::string>());
+            }
+            if (node["headers"]) {
+                for (auto &&h : node["headers"]) {
+                    rt.headers.emplace_back(h.first.as<std::string>(), h.second.as<std::string>());
+                }
+            }
+            if (node["body_size"]) {
+                rt.body_size = node["body_size"].as<byte_size>().size;
+            }
+            return true;
+        }
+    };
+}    // namespace YAML
+
+std::vector<request_template> load_workload(const std::string &file) {
+    auto templates = YAML::LoadFile(file).as<std::vector<request_template>>();
+    if (templates.empty()) {
+        throw std::runtime_error(format("Workload {} defines no request templates", file));
+    }
+    if (std::none_of(templates.begin(), templates.end(), [](auto &t) { return t.weight > 0; })) {
+        throw std::runtime_error(format("Workload {}: at least one template needs a non-zero weight", file));
+    }
+    return templates;
+}
+
+void print_template_stats(const std::vector<request_template> &templates, const std::vector<template_stats> &stats,
+                          uint64_t total_reqs, double secs) {
+    for (unsigned i = 0; i < templates.size(); ++i) {
+        auto &t = templates[i];
+        auto &st = stats[i];
+        fmt::print("Template {:>2} ({}: {} {}, weight {}, {} body bytes)\n", i, t.name, t.method, t.url.pattern(),
+                   t.weight, t.body_size);
+        fmt::print("  Requests           : {:>8} ({:.1f}%)\n", st.requests,
+                   total_reqs ? st.requests * 100.0 / total_reqs : 0.0);
+        fmt::print("  Requests/sec       : {:>8.0f}\n", st.requests / secs);
+        fmt::print("  Throughput         : {:>8.0f} KB/s\n", (st.bytes >> 10) / secs);
+        fmt::print("  Lat average        : {:>8.0f} usec\n", st.latencies.mean());
+        for (auto &q : quantiles) {
+            fmt::print("  Lat quantile={:>5} : {:>8} usec\n", q, st.latencies.quantile(q));
+        }
+        fmt::print("  Lat max            : {:>8} usec\n", st.latencies.max());
+    }
+}
+
 namespace bpo = boost::program_options;
 
 int main(int ac, char **av) {
@@ -180,7 +436,8 @@ int main(int ac, char **av) {
     app.add_options()("server,s", bpo::value<std::string>()->default_value("192.168.66.100:10000"),
                       "Server address")("conn,c", bpo::value<unsigned>()->default_value(100), "total connections")(
         "reqs,r", bpo::value<unsigned>()->default_value(0), "reqs per connection")(
-        "duration,d", bpo::value<unsigned>()->default_value(10), "duration of the test in seconds)");
+        "duration,d", bpo::value<unsigned>()->default_value(10), "duration of the test in seconds)")(
+        "workload,w", bpo::value<std::string>(), "YAML file with weighted request templates (default: GET /)");
 
     return app.run(ac, av, [&app]() -> future<int> {
         auto &config = app.configuration();
@@ -194,6 +451,11 @@ int main(int ac, char **av) {
             return make_ready_future<int>(-1);
         }
 
+        std::vector<request_template> templates(1);
+        if (config.count("workload")) {
+            templates = load_workload(config["workload"].as<std::string>());
+        }
+
         auto http_clients = new distributed<http_client>;
 
         // Start http requests on all the cores
@@ -203,14 +465,31 @@ int main(int ac, char **av) {
         fmt::print("Connections: {:d}\n", total_conn);
         fmt::print("Requests/connection: {}\n",
                    reqs_per_conn == 0 ? "dynamic (timer based)" : std::to_string(reqs_per_conn));
-        return http_clients->start(std::move(duration), std::move(total_conn), std::move(reqs_per_conn))
+        fmt::print("Request templates: {:d}\n", templates.size());
+        return http_clients->start(std::move(duration), std::move(total_conn), std::move(reqs_per_conn), templates,
+                                   sstring(server))
             .then([http_clients, server] {
                 return http_clients->invoke_on_all(&http_client::connect, ipv4_addr {server});
             })
             .then([http_clients] { return http_clients->invoke_on_all(&http_client::run); })
             .then([http_clients] { return http_clients->map_reduce(adder<uint64_t>(), &http_client::total_reqs); })
-            .then([http_clients, started](auto total_reqs) {
+            .then([http_clients, templates](auto total_reqs) {
+                return http_clients
+                    ->map_reduce0([](http_client &c) { return c.stats(); },
+                                  std::vector<template_stats>(templates.size()),
+                                  [](std::vector<template_stats> res, const std::vector<template_stats> &shard) {
+                                      for (unsigned i = 0; i < res.size(); ++i) {
+                                          res[i] += shard[i];
+                                      }
+                                      return res;
+                                  })
+                    .then([total_reqs](std::vector<template_stats> stats) {
+                        return std::make_pair(total_reqs, std::move(stats));
+                    });
+            })
+            .then([http_clients, started, templates](auto results) {
                 // All the http requests are finished
+                auto total_reqs = results.first;
                 auto finished = steady_clock_type::now();
                 auto elapsed = finished - started;
                 auto secs = static_cast<double>(elapsed.count() / 1000000000.0);
@@ -218,6 +497,7 @@ int main(int ac, char **av) {
                 fmt::print("Total requests: {:d}\n", total_reqs);
                 fmt::print("Total time: {:f}\n", secs);
                 fmt::print("Requests/sec: {:f}\n", static_cast<double>(total_reqs) / secs);
+                print_template_stats(templates, results.second, total_reqs, secs);
                 fmt::print("==========     done     ============\n");
                 return http_clients->stop().then([http_clients] {
                     // FIXME: If we call engine().exit(0) here to exit when
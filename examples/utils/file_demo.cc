@@ -41,6 +41,8 @@
 #include <nil/actor/detail/log.hh>
 #include <nil/actor/detail/tmp_file.hh>
 
+#include "../apps/lib/coalescing_file.hh"
+
 using namespace nil::actor;
 
 constexpr size_t aligned_size = 4096;
@@ -226,10 +228,51 @@ future<> demo_with_io_intent() {
     });
 }
 
+future<> demo_with_queued_io_intent() {
+    fmt::print("\nDemonstrating demo_with_queued_io_intent():\n");
+    return tmp_dir::do_with_thread([](tmp_dir &t) {
+        sstring filename = (t.get_path() / "testfile.tmp").native();
+        auto f = open_file_dma(filename, open_flags::rw | open_flags::create).get0();
+        constexpr size_t nr_reads = 16;
+
+        auto wbuf = temporary_buffer<char>::aligned(aligned_size, aligned_size * nr_reads);
+        std::fill(wbuf.get_write(), wbuf.get_write() + wbuf.size(), 'x');
+        f.dma_write(0, wbuf.get(), wbuf.size()).get();
+
+        // one I/O at a time, so all reads but the first are queued in the coalescing file
+        actor_apps_lib::coalescing_file cf(f, 1);
+        io_intent intent;
+        auto rbuf = temporary_buffer<char>::aligned(aligned_size, aligned_size * nr_reads);
+        std::vector<future<size_t>> reads;
+        fmt::print("  issuing {} reads, every other one attached to the intent\n", nr_reads);
+        for (size_t i = 0; i < nr_reads; i++) {
+            auto pos = i * aligned_size;
+            reads.push_back(cf.dma_read(pos, rbuf.get_write() + pos, aligned_size, i % 2 ? &intent : nullptr));
+        }
+
+        fmt::print("  cancel the intent\n");
+        auto reclaimed = cf.cancel(intent);
+        fmt::print("    {} queued bytes removed without doing I/O\n", reclaimed);
+
+        size_t done = 0;
+        for (size_t i = 0; i < nr_reads; i++) {
+            try {
+                done += reads[i].get0();
+            } catch (cancelled_error &ex) {
+                assert(i % 2);
+            }
+        }
+        fmt::print("  {} bytes read, {} reads cancelled\n", done, cf.read_stats().cancelled);
+        assert(done >= aligned_size * nr_reads / 2);
+        f.close().get();
+    });
+}
+
 int main(int ac, char **av) {
     app_template app;
     return app.run(ac, av, [] {
         return demo_with_file().then(
-            [] { return demo_with_file_close_on_failure().then([] { return demo_with_io_intent(); }); });
+            [] { return demo_with_file_close_on_failure().then([] { return demo_with_io_intent(); }); })
+            .then([] { return demo_with_queued_io_intent(); });
     });
 }
@@ -22,8 +22,8 @@
 // SOFTWARE.
 //---------------------------------------------------------------------------//
 
-// Demonstration of file_input_stream.  Don't expect stellar performance
-// since no read-ahead or caching is done yet.
+// Demonstration of file_input_stream. The stream reads ahead, with up to
+// 8 reads of 128k in flight once it sees the file is read sequentially.
 
 #include <nil/actor/core/fstream.hh>
 #include <nil/actor/core/core.hh>
@@ -33,11 +33,13 @@
 #include <algorithm>
 #include <iostream>
 
+#include "../apps/lib/file_read_ahead.hh"
+
 using namespace nil::actor;
 
 struct reader {
 public:
-    reader(file f) : is(make_file_input_stream(std::move(f), file_input_stream_options {1 << 16, 1})) {
+    reader(file f) : is(actor_apps_lib::make_read_ahead_file_input_stream(std::move(f))) {
     }
 
     input_stream<char> is;